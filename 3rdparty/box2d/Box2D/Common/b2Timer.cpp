@@ -20,7 +20,7 @@
 
 #if defined(_WIN32)
 
-float64 b2Timer::s_invFrequency = 0.0f;
+thread_local float64 b2Timer::s_invFrequency = 0.0f;
 
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
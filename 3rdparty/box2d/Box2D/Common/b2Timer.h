@@ -40,7 +40,8 @@ private:
 
 #if defined(_WIN32)
 	float64 m_start;
-	static float64 s_invFrequency;
+	// Thread local since timers are created while stepping.
+	static thread_local float64 s_invFrequency;
 #elif defined(__linux__) || defined (__APPLE__)
 	unsigned long long m_start_sec;
 	unsigned long long m_start_usec;
@@ -68,11 +68,15 @@ void b2Contact::AddType(b2ContactCreateFcn* createFcn, b2ContactDestroyFcn* dest
 
 b2Contact* b2Contact::Create(b2Fixture* fixtureA, int32 indexA, b2Fixture* fixtureB, int32 indexB, b2BlockAllocator* allocator)
 {
-	if (s_initialized == false)
+	// A local static so the first contacts of worlds stepped in
+	// parallel can't initialize the registers at the same time.
+	static const bool initialized = []()
 	{
 		InitializeRegisters();
 		s_initialized = true;
-	}
+		return true;
+	}();
+	(void)initialized;
 
 	b2Shape::Type type1 = fixtureA->GetType();
 	b2Shape::Type type2 = fixtureB->GetType();
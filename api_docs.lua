@@ -53,6 +53,22 @@ is_valid() -> boolean
 -- Current layer of this object.
 this_layer -> layer
 
+-- Only set during the Collision Begin and Collision End events.
+-- Lists every object that started or stopped touching this
+-- object since the last frame. Each object is listed once.
+collisions -> array[collision_info]
+
+collision_info = {
+    object, -- (object handle) Handle to the other object.
+            --   Note: this may be nil if the object is a plain sprite asset or a tilemap.
+}
+-- Usage (in a Collision Begin event):
+    for _, collision in ipairs(collisions) do
+        if collision.object then
+            dprint("touched " .. tostring(collision.object))
+        end
+    end
+
 -----------
 -- Graphics
 -----------
@@ -260,3 +276,23 @@ physics_raycast_each(func, pointa, pointb) -> boolean
 -- Returns true if there is a collision in the aabb specified.
 -- Min is the top-left corner of the box and max is the bottom-right corner.
 physics_test_aabb(min, max) -> boolean
+
+-- Sends many rays at once. Each ray is a table of { pointa, pointb }.
+-- Returns an array with a hit_info for every ray that hit something, else false.
+-- Large batches run on several threads so this is a lot faster than
+-- calling physics_raycast in a loop.
+physics_raycast_batch(rays) -> array
+-- Usage:
+    local rays = {
+        { math.vec2(0, 0), math.vec2(1, 0) },
+        { math.vec2(0, 0), math.vec2(0, 1) },
+    }
+    for i, hit_info in ipairs(physics_raycast_batch(rays)) do
+        if hit_info then
+            dprint("ray " .. i .. " hit at " .. tostring(hit_info.point))
+        end
+    end
+
+-- Tests many aabbs at once. Each aabb is a table of { min, max }.
+-- Returns an array of booleans in the same order.
+physics_test_aabb_batch(aabbs) -> array
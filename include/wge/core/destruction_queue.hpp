@@ -36,7 +36,7 @@ public:
 
 	bool empty() const noexcept
 	{
-		return mObjects_queue.empty() || mComponents_queue.empty();
+		return mObjects_queue.empty() && mComponents_queue.empty();
 	}
 
 	void clear() noexcept
@@ -7,6 +7,8 @@
 #include <wge/physics/physics_world.hpp>
 #include <wge/graphics/camera.hpp>
 
+#include <vector>
+
 namespace wge::core
 {
 
@@ -20,8 +22,47 @@ public:
 	void load_game(const filesystem::path& pPath);
 	void close_game();
 
+	// Advance the game by the time that really passed. Runs as many
+	// fixed ticks as fit and interpolates physics objects for rendering.
+	void update(float pElapsed);
+	// Run a single tick.
 	void step();
 
+	// Default: 60 ticks per second
+	void set_tick_rate(float pTicks_per_second) noexcept
+	{
+		mTick_duration = 1.f / pTicks_per_second;
+	}
+
+	float get_tick_duration() const noexcept
+	{
+		return mTick_duration;
+	}
+
+	// Only simulate physics bodies within this many units of the default
+	// camera's view. 0 (the default) simulates everything.
+	void set_physics_activity_range(float pUnits) noexcept
+	{
+		mPhysics_activity_range = pUnits;
+	}
+
+	float get_physics_activity_range() const noexcept
+	{
+		return mPhysics_activity_range;
+	}
+
+	// Save the physics of the scene, isolated layer worlds included.
+	// See physics::physics_world::checkpoint.
+	physics::scene_physics_snapshot checkpoint_physics()
+	{
+		return mPhysics.checkpoint(mScene);
+	}
+
+	void restore_physics(const physics::scene_physics_snapshot& pSnapshot)
+	{
+		mPhysics.restore(pSnapshot, mScene);
+	}
+
 	bool is_loaded() const;
 
 	core::game_settings& get_settings() noexcept
@@ -70,6 +111,13 @@ private:
 	graphics::camera mDefault_camera;
 	scripting::script_engine mLua_engine{ mAsset_manager };
 	physics::physics_world mPhysics;
+	// Worlds of layers with isolated_physics. Refilled every tick.
+	std::vector<physics::physics_world*> mIsolated_worlds;
+
+	float mTick_duration{ 1.f / 60.f };
+	// Time that has passed but wasn't enough for a tick.
+	float mTick_accumulator{ 0 };
+	float mPhysics_activity_range{ 0 };
 
 	bool mLoaded{ false };
 };
@@ -7,6 +7,7 @@
 #include <wge/core/destruction_queue.hpp>
 #include <wge/util/ptr.hpp>
 
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -200,6 +201,7 @@ public:
 		typename = std::enable_if_t<!std::is_same_v<U, bucket>>>
 	auto* add_component(const object_id& pObject_id, T&& pComponent, bucket pBucket = default_bucket)
 	{
+		++mVersion;
 		return &mComponent_manager.add_component(pObject_id, std::forward<T>(pComponent), pBucket);
 	}
 
@@ -233,6 +235,7 @@ public:
 	template <typename T>
 	bool remove_component(object_id pObject_id, bucket pBucket = default_bucket)
 	{
+		++mVersion;
 		mComponent_manager.remove_component<T>(pObject_id, pBucket);
 	}
 
@@ -285,9 +288,26 @@ public:
 
 	void destroy_queued_components()
 	{
+		// This runs every frame so only bump the version if something goes.
+		if (mDestruction_queue.empty())
+			return;
+		++mVersion;
 		mDestruction_queue.apply(mComponent_manager);
 	}
 
+	// Changes whenever objects or components are added or removed.
+	// Components can be edited through pointers without the layer
+	// knowing so whoever does that should call mark_changed().
+	std::uint64_t get_version() const noexcept
+	{
+		return mVersion;
+	}
+
+	void mark_changed() noexcept
+	{
+		++mVersion;
+	}
+
 	// These components are for the layer.
 	// With this, the layer is pretty much an object itself.
 	// Made public for convenience.
@@ -299,6 +319,7 @@ private:
 
 	float mTime_scale{ 1 };
 	bool mRecieve_update{ true };
+	std::uint64_t mVersion{ 0 };
 	std::string mName;
 	// Because we can't remove components while iterating them
 	// we can queue those components to be removed after the iteration
@@ -442,6 +463,7 @@ filter(component_storage<T>&, component_storage<Tdeps>&...) -> filter<T, Tdeps..
 template<typename T>
 inline auto* layer::add_component(const object_id& pObject_id, bucket pBucket)
 {
+	++mVersion;
 	return &mComponent_manager.add_component<T>(pObject_id, pBucket);
 }
 
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <wge/math/vector.hpp>
+#include <wge/util/enum.hpp>
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace wge::core
+{
+
+// Tiles are grouped into square chunks of this many tiles per side
+// so they can be stored, rebuilt, and culled together.
+constexpr int tilemap_chunk_size = 32;
+
+// Get the chunk that a tile position belongs to.
+inline math::ivec2 get_tilemap_chunk(math::ivec2 pPosition) noexcept
+{
+	// Round towards negative infinity so negative positions work as expected.
+	const auto floor_div = [](int pValue) -> int
+	{
+		return pValue >= 0 ? pValue / tilemap_chunk_size : (pValue - tilemap_chunk_size + 1) / tilemap_chunk_size;
+	};
+	return{ floor_div(pPosition.x), floor_div(pPosition.y) };
+}
+
+// Packs a chunk position into a single key.
+inline std::uint64_t get_tilemap_chunk_key(math::ivec2 pChunk) noexcept
+{
+	return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(pChunk.x)) << 32)
+		| static_cast<std::uint64_t>(static_cast<std::uint32_t>(pChunk.y));
+}
+
+enum class tile_flags : std::uint16_t
+{
+	none = 0,
+	// The cell has a tile in it.
+	occupied = 1,
+};
+ENUM_CLASS_FLAG_OPERATORS(tile_flags);
+
+// A single cell of a tile_grid.
+struct tile_cell
+{
+	// Position of the tile in the tileset (in tiles, not pixels).
+	std::uint16_t uv_x{ 0 }, uv_y{ 0 };
+	tile_flags flags{ tile_flags::none };
+
+	bool is_occupied() const noexcept
+	{
+		return flags & tile_flags::occupied;
+	}
+
+	math::ivec2 get_uv() const noexcept
+	{
+		return{ static_cast<int>(uv_x), static_cast<int>(uv_y) };
+	}
+};
+static_assert(sizeof(tile_cell) == 6, "tile_cell should be 6 bytes");
+
+// Dense storage for tiles. Tiles are kept in fixed size chunks that
+// are only allocated when something is placed in them so large or
+// sparse maps don't waste memory.
+class tile_grid
+{
+public:
+	struct chunk
+	{
+		// Position of the chunk in chunks.
+		math::ivec2 position;
+		// Changes every time a tile in this chunk changes.
+		// Versions are unique within the grid so a removed and recreated
+		// chunk will never have the same version as before.
+		std::uint64_t version{ 0 };
+		std::size_t tile_count{ 0 };
+		std::array<tile_cell, tilemap_chunk_size * tilemap_chunk_size> cells{};
+
+		math::ivec2 get_tile_position(std::size_t pIndex) const noexcept
+		{
+			return position * tilemap_chunk_size + math::ivec2{
+				static_cast<int>(pIndex % tilemap_chunk_size),
+				static_cast<int>(pIndex / tilemap_chunk_size) };
+		}
+	};
+
+	using chunk_map = std::unordered_map<std::uint64_t, chunk>;
+
+	// Returns nullptr if there is no tile at this position.
+	const tile_cell* get(math::ivec2 pPosition) const
+	{
+		auto iter = mChunks.find(get_tilemap_chunk_key(get_tilemap_chunk(pPosition)));
+		if (iter == mChunks.end())
+			return nullptr;
+		const tile_cell& cell = iter->second.cells[get_cell_index(pPosition)];
+		return cell.is_occupied() ? &cell : nullptr;
+	}
+
+	// True if the uv can be stored in a tile_cell.
+	static bool is_valid_uv(math::ivec2 pUV) noexcept
+	{
+		constexpr int max_uv = std::numeric_limits<std::uint16_t>::max();
+		return pUV.x >= 0 && pUV.y >= 0 && pUV.x <= max_uv && pUV.y <= max_uv;
+	}
+
+	// Place a tile. Returns false if the same tile was already there.
+	// Uvs that don't fit in a tile_cell are rejected instead of wrapping
+	// around to some other tile.
+	bool set(math::ivec2 pPosition, math::ivec2 pUV)
+	{
+		if (!is_valid_uv(pUV))
+			return false;
+		chunk& c = get_or_create_chunk(get_tilemap_chunk(pPosition));
+		tile_cell& cell = c.cells[get_cell_index(pPosition)];
+		const tile_cell new_cell{
+			static_cast<std::uint16_t>(pUV.x),
+			static_cast<std::uint16_t>(pUV.y),
+			tile_flags::occupied };
+		if (cell.is_occupied() && cell.uv_x == new_cell.uv_x && cell.uv_y == new_cell.uv_y)
+			return false;
+		if (!cell.is_occupied())
+			++c.tile_count;
+		cell = new_cell;
+		c.version = ++mVersion_counter;
+		return true;
+	}
+
+	// Remove a tile. Returns false if there was no tile.
+	bool clear(math::ivec2 pPosition)
+	{
+		auto iter = mChunks.find(get_tilemap_chunk_key(get_tilemap_chunk(pPosition)));
+		if (iter == mChunks.end())
+			return false;
+		tile_cell& cell = iter->second.cells[get_cell_index(pPosition)];
+		if (!cell.is_occupied())
+			return false;
+		cell = tile_cell{};
+		if (--iter->second.tile_count == 0)
+			mChunks.erase(iter);
+		else
+			iter->second.version = ++mVersion_counter;
+		return true;
+	}
+
+	// Set every tile in the range [pMin, pMax).
+	void fill(math::ivec2 pMin, math::ivec2 pMax, math::ivec2 pUV)
+	{
+		for (int y = pMin.y; y < pMax.y; y++)
+			for (int x = pMin.x; x < pMax.x; x++)
+				set({ x, y }, pUV);
+	}
+
+	// Remove every tile in the range [pMin, pMax).
+	void clear(math::ivec2 pMin, math::ivec2 pMax)
+	{
+		for (int y = pMin.y; y < pMax.y; y++)
+			for (int x = pMin.x; x < pMax.x; x++)
+				clear({ x, y });
+	}
+
+	// Copy the tiles in the range [pMin, pMax) so pMin lands on pDestination.
+	// Empty cells in the source clear the destination. Overlapping ranges are fine.
+	void copy(math::ivec2 pMin, math::ivec2 pMax, math::ivec2 pDestination)
+	{
+		if (pMax.x <= pMin.x || pMax.y <= pMin.y)
+			return;
+		const math::ivec2 size = pMax - pMin;
+
+		// Read everything first in case the ranges overlap.
+		std::vector<tile_cell> buffer;
+		buffer.reserve(static_cast<std::size_t>(size.x) * static_cast<std::size_t>(size.y));
+		for (int y = pMin.y; y < pMax.y; y++)
+			for (int x = pMin.x; x < pMax.x; x++)
+			{
+				const tile_cell* cell = get({ x, y });
+				buffer.push_back(cell ? *cell : tile_cell{});
+			}
+
+		for (int y = 0; y < size.y; y++)
+			for (int x = 0; x < size.x; x++)
+			{
+				const tile_cell& cell = buffer[static_cast<std::size_t>(y) * size.x + x];
+				const math::ivec2 position = pDestination + math::ivec2{ x, y };
+				if (cell.is_occupied())
+					set(position, cell.get_uv());
+				else
+					clear(position);
+			}
+	}
+
+	// Remove all the tiles.
+	void clear_all() noexcept
+	{
+		mChunks.clear();
+	}
+
+	// Give every chunk a new version so anything cached
+	// from this grid gets rebuilt.
+	void touch_all() noexcept
+	{
+		for (auto& [key, c] : mChunks)
+			c.version = ++mVersion_counter;
+	}
+
+	// Calls pCallback(math::ivec2 position, const tile_cell&) for every tile.
+	template <typename Tcallback>
+	void for_each(Tcallback&& pCallback) const
+	{
+		for (auto& [key, c] : mChunks)
+			for (std::size_t i = 0; i < c.cells.size(); i++)
+				if (c.cells[i].is_occupied())
+					pCallback(c.get_tile_position(i), c.cells[i]);
+	}
+
+	const chunk_map& get_chunks() const noexcept
+	{
+		return mChunks;
+	}
+
+	std::size_t get_tile_count() const noexcept
+	{
+		std::size_t count = 0;
+		for (auto& [key, c] : mChunks)
+			count += c.tile_count;
+		return count;
+	}
+
+	bool empty() const noexcept
+	{
+		return mChunks.empty();
+	}
+
+private:
+	static std::size_t get_cell_index(math::ivec2 pPosition) noexcept
+	{
+		const math::ivec2 local = pPosition - get_tilemap_chunk(pPosition) * tilemap_chunk_size;
+		return static_cast<std::size_t>(local.y) * tilemap_chunk_size + static_cast<std::size_t>(local.x);
+	}
+
+	chunk& get_or_create_chunk(math::ivec2 pChunk)
+	{
+		auto [iter, inserted] = mChunks.try_emplace(get_tilemap_chunk_key(pChunk));
+		if (inserted)
+			iter->second.position = pChunk;
+		return iter->second;
+	}
+
+private:
+	chunk_map mChunks;
+	std::uint64_t mVersion_counter{ 0 };
+};
+
+} // namespace wge::core
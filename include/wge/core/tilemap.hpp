@@ -7,6 +7,7 @@
 #include <wge/graphics/texture.hpp>
 #include <wge/graphics/render_batch_2d.hpp>
 #include <wge/math/vector.hpp>
+#include <wge/core/tile_grid.hpp>
 
 namespace wge::core
 {
@@ -21,65 +22,43 @@ struct tilemap_info
 	core::resource_handle<graphics::tileset> tileset;
 };
 
-struct tile_animation
+// Get the uv rect of a tile in a tileset.
+inline math::rect get_tile_uvrect(const graphics::tileset& pTileset, math::ivec2 pUV)
 {
-	float timer = 0;
-	math::ivec2 start_frame;
-	std::size_t frame_count;
-	float interval;
-};
+	auto tile_uv_size = math::vec2(pTileset.tile_size) / math::vec2(pTileset.get_texture().get_size());
+	return math::rect(math::vec2(pUV) * tile_uv_size, tile_uv_size);
+}
 
 struct tilemap_manipulator
 {
 public:
 	tilemap_manipulator(layer& pLayer) :
 		mLayer(&pLayer),
-		mInfo(pLayer.layer_components.get<tilemap_info>())
+		mInfo(pLayer.layer_components.get<tilemap_info>()),
+		mGrid(pLayer.layer_components.get<tile_grid>())
 	{
 		if (!mInfo)
 			mInfo = mLayer->layer_components.insert(tilemap_info{});
+		if (!mGrid)
+			mGrid = mLayer->layer_components.insert(tile_grid{});
 	}
 
-	object find_tile(math::ivec2 pPosition)
-	{
-		for (auto& [id, tile] : mLayer->each<core::tile>())
-			if (tile.position == pPosition)
-				return mLayer->get_object(id);
-		return object{};
-	}
-
-	void update_animations(float pDelta)
+	// Returns nullptr if there is no tile at this position.
+	const tile_cell* find_tile(math::ivec2 pPosition) const
 	{
-		for (auto& [id, animation, tile, quad] :
-			mLayer->each<tile_animation, tile, graphics::quad_vertices>())
-		{
-			animation.timer += pDelta;
-		}
+		return mGrid->get(pPosition);
 	}
 
 	bool clear_tile(math::ivec2 pPosition)
 	{
-		if (object tile = find_tile(pPosition))
-		{
-			tile.destroy();
-			return true;
-		}
-		return false;
-	}
-
-	bool clear_tile(queue_destruction_flag, math::ivec2 pPosition)
-	{
-		if (object tile = find_tile(pPosition))
-		{
-			tile.destroy(queue_destruction);
-			return true;
-		}
-		return false;
+		return mGrid->clear(pPosition);
 	}
 
 	void set_tileset(core::resource_handle<graphics::tileset> pTileset)
 	{
 		mInfo->tileset = pTileset;
+		// The uvs depend on the tileset so everything needs to be rebuilt.
+		mGrid->touch_all();
 	}
 
 	core::resource_handle<graphics::tileset> get_tileset() const
@@ -94,63 +73,48 @@ public:
 		return mInfo->tileset->tile_size;
 	}
 
+	void set_tile(const tile& pTile)
+	{
+		mGrid->set(pTile.position, pTile.uv);
+	}
 
-	object set_tile(const tile& pTile)
+	void set_tile(math::ivec2 pPosition, math::ivec2 pUV)
 	{
-		if (object existing = find_tile(pTile.position))
-		{
-			// Update the uv of an existing tile.
-			auto tile_comp = existing.get_component<tile>();
-			tile_comp->uv = pTile.uv;
-			auto quad_comp = existing.get_component<graphics::quad_vertices>();
-			quad_comp->set_uv(get_uvrect(pTile.uv));
-			return existing;
-		}
-		else
-		{
-			// Create a new object for the tile.
-			object new_tile = mLayer->add_object();
-
-			new_tile.add_component(pTile);
-
-			graphics::quad_vertices quad_verts;
-			quad_verts.set_rect(math::rect(math::vec2(pTile.position), math::vec2(1, 1)));
-			quad_verts.set_uv(get_uvrect(pTile.uv));
-			new_tile.add_component(quad_verts);
-			new_tile.add_component(graphics::quad_indicies{});
-
-			return new_tile;
-		}
+		set_tile(tile{ pPosition, pUV });
 	}
 
-	object set_tile(math::ivec2 pPosition, math::ivec2 pUV)
+	// Set every tile in the range [pMin, pMax).
+	void fill(math::ivec2 pMin, math::ivec2 pMax, math::ivec2 pUV)
 	{
-		return set_tile(tile{ pPosition, pUV });
+		mGrid->fill(pMin, pMax, pUV);
+	}
+
+	// Copy the tiles in the range [pMin, pMax) so pMin lands on pDestination.
+	void copy(math::ivec2 pMin, math::ivec2 pMax, math::ivec2 pDestination)
+	{
+		mGrid->copy(pMin, pMax, pDestination);
 	}
 
 	void update_tile_uvs()
 	{
-		if (!mInfo->tileset)
-			return;
-		for (auto& [id, tile, quad_verts] : mLayer->each<tile, graphics::quad_vertices>())
-			quad_verts.set_uv(get_uvrect(tile.uv));
+		// Uvs are calculated when the chunks are rebuilt.
+		mGrid->touch_all();
 	}
 
-private:
-	math::rect get_uvrect(math::ivec2 pUV) const
+	tile_grid& get_grid() noexcept
 	{
-		if (mInfo->tileset)
-		{
-			auto tile_uv_size = math::vec2(mInfo->tileset->tile_size) / math::vec2(mInfo->tileset->get_texture().get_size());
-			return math::rect(math::vec2(pUV) * tile_uv_size, tile_uv_size);
-		}
-		else
-			return math::rect{};
+		return *mGrid;
+	}
+
+	const tile_grid& get_grid() const noexcept
+	{
+		return *mGrid;
 	}
 
 private:
-	tilemap_info* mInfo;
 	layer* mLayer;
+	tilemap_info* mInfo;
+	tile_grid* mGrid;
 };
 
 inline bool is_tilemap_layer(const layer& pLayer) noexcept
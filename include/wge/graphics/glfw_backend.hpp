@@ -22,6 +22,8 @@ public:
 	virtual void refresh() override;
 	virtual void serialize_settings(json&) override;
 	virtual void deserialize_settings(const json&) override;
+	virtual void make_context_current() override;
+	virtual void release_context() override;
 
 	GLFWwindow* get_window() const;
 
@@ -2,6 +2,11 @@
 
 #include <wge/graphics/render_batch_2d.hpp>
 #include <wge/graphics/graphics_backend.hpp>
+#include <wge/graphics/texture_atlas.hpp>
+#include <wge/graphics/recording_backend.hpp>
+#include <wge/util/thread_pool.hpp>
+
+#include <memory>
 
 namespace wge::graphics
 {
@@ -14,6 +19,9 @@ public:
 		mWindow_backend = window_backend::create(pWindowing, pRendering);
 		mGraphics_backend = graphics_backend::create(pRendering);
 		mGraphics_backend->initialize();
+		mSprite_atlas.set_graphics_backend(mGraphics_backend);
+		if (!mThread_pool)
+			mThread_pool = std::make_unique<util::thread_pool>();
 	}
 
 	window_backend::ptr get_window_backend() const
@@ -26,6 +34,25 @@ public:
 		return mGraphics_backend;
 	}
 
+	// Wrap the graphics backend so everything drawn with it is counted.
+	// Call after initialize.
+	recording_backend& enable_draw_recording()
+	{
+		if (!mRecorder)
+		{
+			mRecorder = std::make_shared<recording_backend>(mGraphics_backend);
+			mGraphics_backend = mRecorder;
+			mSprite_atlas.set_graphics_backend(mGraphics_backend);
+		}
+		return *mRecorder;
+	}
+
+	// nullptr if recording is not enabled.
+	recording_backend* get_draw_recorder() const noexcept
+	{
+		return mRecorder.get();
+	}
+
 	void set_pixels_per_unit_sq(float pPixels) noexcept
 	{
 		mPixels_per_unit_sq = pPixels;
@@ -36,11 +63,41 @@ public:
 		return mPixels_per_unit_sq;
 	}
 
+	// What textures loaded from assets do with their
+	// pixels once they are uploaded. Sprites packed into the
+	// atlas are still kept on the cpu by its pages.
+	void set_image_residency(image_residency pResidency) noexcept
+	{
+		mImage_residency = pResidency;
+	}
+
+	image_residency get_image_residency() const noexcept
+	{
+		return mImage_residency;
+	}
+
+	// Sprites are packed into this so they can share textures.
+	texture_atlas& get_sprite_atlas() noexcept
+	{
+		return mSprite_atlas;
+	}
+
+	// Workers for building render commands.
+	// nullptr until initialized.
+	util::thread_pool* get_thread_pool() const noexcept
+	{
+		return mThread_pool.get();
+	}
+
 private:
 	float mPixels_per_unit_sq = 1;
+	image_residency mImage_residency{ image_residency::discard };
 
 	window_backend::ptr mWindow_backend;
 	graphics_backend::ptr mGraphics_backend;
+	std::shared_ptr<recording_backend> mRecorder;
+	texture_atlas mSprite_atlas;
+	std::unique_ptr<util::thread_pool> mThread_pool;
 };
 
 } // namespace wge::graphics
@@ -8,6 +8,7 @@
 
 #include <memory>
 #include <functional>
+#include <string_view>
 
 namespace wge::graphics
 {
@@ -21,7 +22,9 @@ enum class window_backend_type
 enum class backend_type
 {
 	null,
-	opengl
+	opengl,
+	// Renders on the cpu. Only works with the null window backend.
+	software
 };
 
 class window_backend
@@ -38,6 +41,10 @@ public:
 	virtual void refresh() = 0;
 	virtual void serialize_settings(json&) {}
 	virtual void deserialize_settings(const json&) {}
+	// The graphics context can only be current on one thread at a time.
+	// These move it between threads. Backends without one do nothing.
+	virtual void make_context_current() {}
+	virtual void release_context() {}
 
 	util::signal<void()> on_close;
 	util::signal<void(int, const char**)> on_file_drop;
@@ -54,6 +61,21 @@ public:
 	virtual void render_batch(const framebuffer::ptr& mFramebuffer, const math::mat44& pProjection, const render_batch_2d& pBatch) = 0;
 	virtual framebuffer::ptr create_framebuffer() = 0;
 	virtual texture_impl::ptr create_texture_impl() = 0;
+	// Textures that skip the upload queue and upload as soon as their
+	// image is set. Used by atlas pages since their uvs change right away.
+	virtual texture_impl::ptr create_immediate_texture_impl() { return create_texture_impl(); }
+	// Returns true if batches with instances can be rendered.
+	virtual bool supports_instancing() const { return false; }
+	// Returns nullptr if the backend can't keep geometry on the gpu.
+	virtual retained_geometry::ptr create_retained_geometry() { return {}; }
+	// Called by the renderer before the batches of a layer are drawn.
+	// Only used for debugging and instrumentation.
+	virtual void begin_layer(std::string_view pName) {}
+	// Backends that upload textures in the background finish
+	// some of them here. Called by the renderer before it builds anything.
+	virtual void process_uploads() {}
+	// Limits how many bytes of textures each process_uploads call can upload.
+	virtual void set_upload_budget(std::size_t pBytes) {}
 };
 
 } // namespace wge::graphics
@@ -122,6 +122,11 @@ public:
 		return util::span{ mData };
 	}
 
+	auto get_raw() noexcept
+	{
+		return util::span{ mData };
+	}
+
 	const char* get_error() const noexcept
 	{
 		return mError_msg;
@@ -3,13 +3,96 @@
 #include <wge/graphics/texture.hpp>
 #include <GL/glew.h>
 
+#include <cstring>
+#include <deque>
+#include <memory>
+
 namespace wge::graphics
 {
 
+class opengl_texture_impl;
+
+// Textures waiting to be uploaded to the gpu.
+// Uploads go through a pixel buffer object so the driver can copy them
+// in the background, and only so many bytes are uploaded each frame.
+class opengl_upload_queue
+{
+public:
+	~opengl_upload_queue()
+	{
+		glDeleteTextures(1, &mPlaceholder);
+		glDeleteBuffers(1, &mPixel_buffer);
+	}
+
+	// Requires a context.
+	void initialize()
+	{
+		glGenBuffers(1, &mPixel_buffer);
+
+		// Bound in place of textures that aren't uploaded yet.
+		const unsigned char transparent[4] = { 0, 0, 0, 0 };
+		glGenTextures(1, &mPlaceholder);
+		glBindTexture(GL_TEXTURE_2D, mPlaceholder);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, transparent);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void push(const std::shared_ptr<opengl_texture_impl>& pTexture)
+	{
+		mPending.push_back(pTexture);
+	}
+
+	// Upload pending textures until the budget is used up. At least one
+	// texture is uploaded every time so large ones can't get stuck.
+	void process();
+
+	void set_budget(std::size_t pBytes) noexcept
+	{
+		mBudget = pBytes;
+	}
+
+	std::size_t get_budget() const noexcept
+	{
+		return mBudget;
+	}
+
+	std::size_t get_pending_count() const noexcept
+	{
+		return mPending.size();
+	}
+
+	GLuint get_placeholder() const noexcept
+	{
+		return mPlaceholder;
+	}
+
+	GLuint get_pixel_buffer() const noexcept
+	{
+		return mPixel_buffer;
+	}
+
+private:
+	std::deque<std::weak_ptr<opengl_texture_impl>> mPending;
+	// Bytes per frame.
+	std::size_t mBudget{ 8 * 1024 * 1024 };
+	GLuint mPlaceholder{ 0 };
+	GLuint mPixel_buffer{ 0 };
+};
+
 class opengl_texture_impl :
-	public texture_impl
+	public texture_impl,
+	public std::enable_shared_from_this<opengl_texture_impl>
 {
 public:
+	// Uploads immediately.
+	opengl_texture_impl() = default;
+	// Uploads through the queue.
+	opengl_texture_impl(const std::shared_ptr<opengl_upload_queue>& pQueue) :
+		mQueue(pQueue)
+	{}
+
 	virtual ~opengl_texture_impl()
 	{
 		glDeleteTextures(1, &mGL_texture);
@@ -17,24 +100,28 @@ public:
 
 	virtual void create_from_image(const image& pImage) override
 	{
-		if (!mGL_texture)
+		if (mQueue)
 		{
-			// Create the texture object
-			glGenTextures(1, &mGL_texture);
+			// Setting the image again before the upload just replaces what is uploaded.
+			mPending_image = pImage;
+			if (!mQueued)
+			{
+				mQueued = true;
+				mQueue->push(shared_from_this());
+			}
+			return;
 		}
-
-		// Give the image to OpenGL
-		glBindTexture(GL_TEXTURE_2D, mGL_texture);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pImage.get_width(), pImage.get_height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, pImage.get_raw().data());
-		glBindTexture(GL_TEXTURE_2D, 0);
-
-		update_filtering();
+		upload(pImage.get_width(), pImage.get_height(), pImage.get_raw().data());
 	}
 
 	virtual void set_smooth(bool pSmooth) override
 	{
+		if (pSmooth == mSmooth)
+			return;
 		mSmooth = pSmooth;
-		update_filtering();
+		// Filtering is set when the texture is uploaded otherwise.
+		if (mGL_texture)
+			update_filtering();
 	}
 
 	virtual bool is_smooth() const override
@@ -42,12 +129,66 @@ public:
 		return mSmooth;
 	}
 
+	// Returns a placeholder until the first upload is done. The
+	// old image stays bound while it is replaced.
 	GLuint get_gl_texture() const
 	{
-		return mGL_texture;
+		return mGL_texture || !mQueue ? mGL_texture : mQueue->get_placeholder();
+	}
+
+	bool is_upload_pending() const noexcept
+	{
+		return mQueued;
+	}
+
+	// Used by opengl_upload_queue. Returns the amount of bytes uploaded.
+	std::size_t upload_pending(GLuint pPixel_buffer)
+	{
+		mQueued = false;
+		if (mPending_image.empty())
+			return 0;
+
+		const auto pixels = mPending_image.get_raw();
+		const std::size_t size = pixels.size() * sizeof(pixels[0]);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pPixel_buffer);
+		// Orphan the last upload so this doesn't have to wait for it.
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		if (void* staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT))
+		{
+			std::memcpy(staging, pixels.data(), size);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			// The pixels are read from the start of the bound buffer.
+			upload(mPending_image.get_width(), mPending_image.get_height(), nullptr);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+		else
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			upload(mPending_image.get_width(), mPending_image.get_height(), pixels.data());
+		}
+
+		// Free the copy.
+		mPending_image = image{};
+		return size;
 	}
 
 private:
+	void upload(int pWidth, int pHeight, const void* pPixels)
+	{
+		if (!mGL_texture)
+		{
+			// Create the texture object
+			glGenTextures(1, &mGL_texture);
+		}
+
+		// Give the image to OpenGL
+		glBindTexture(GL_TEXTURE_2D, mGL_texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pWidth, pHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, pPixels);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		update_filtering();
+	}
+
 	void update_filtering()
 	{
 		glBindTexture(GL_TEXTURE_2D, mGL_texture);
@@ -62,6 +203,24 @@ private:
 private:
 	bool mSmooth{ false };
 	GLuint mGL_texture{ 0 };
+
+	std::shared_ptr<opengl_upload_queue> mQueue;
+	image mPending_image;
+	bool mQueued{ false };
 };
 
+inline void opengl_upload_queue::process()
+{
+	std::size_t uploaded = 0;
+	while (!mPending.empty() && (uploaded == 0 || uploaded < mBudget))
+	{
+		auto texture = mPending.front().lock();
+		mPending.pop_front();
+		// Destroyed before it got its turn.
+		if (!texture)
+			continue;
+		uploaded += texture->upload_pending(mPixel_buffer);
+	}
+}
+
 } // namespace wge::graphics
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <wge/graphics/graphics_backend.hpp>
+#include <wge/util/json_helpers.hpp>
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace wge::graphics
+{
+
+struct draw_stats
+{
+	std::size_t batches{ 0 };
+	std::size_t vertices{ 0 };
+	std::size_t indexes{ 0 };
+	std::size_t instances{ 0 };
+	// Batches that needed a different texture than the one before it.
+	std::size_t texture_binds{ 0 };
+	// Vertex, index, and instance data sent to the backend. Retained
+	// geometry only counts when it is updated.
+	std::size_t bytes_uploaded{ 0 };
+
+	draw_stats& operator+=(const draw_stats& pOther) noexcept
+	{
+		batches += pOther.batches;
+		vertices += pOther.vertices;
+		indexes += pOther.indexes;
+		instances += pOther.instances;
+		texture_binds += pOther.texture_binds;
+		bytes_uploaded += pOther.bytes_uploaded;
+		return *this;
+	}
+
+	json serialize() const;
+};
+
+struct layer_draw_stats
+{
+	std::string name;
+	draw_stats stats;
+};
+
+struct frame_draw_stats
+{
+	std::uint64_t frame_number{ 0 };
+	draw_stats total;
+	std::vector<layer_draw_stats> layers;
+
+	json serialize() const;
+};
+
+// A batch as it was submitted with copies of everything it referenced.
+struct captured_batch
+{
+	std::string layer;
+	primitive_type type{ primitive_type::triangles };
+	float depth{ 0 };
+	math::mat44 projection;
+	// Index into captured_frame::texture_sizes or -1 for no texture.
+	int texture{ -1 };
+	std::vector<vertex_2d> vertices;
+	std::vector<unsigned int> indexes;
+	std::vector<sprite_instance_2d> instances;
+};
+
+// Every batch of a single frame. Can be saved to json to be diffed
+// or replayed later without the scene that produced it.
+struct captured_frame
+{
+	// Textures can't be captured so only their sizes are kept.
+	std::vector<math::ivec2> texture_sizes;
+	std::vector<captured_batch> batches;
+
+	json serialize() const;
+	void deserialize(const json& pJson);
+
+	// Draw every batch again. pTextures maps the captured texture indexes to
+	// real textures. Batches with missing textures are drawn with flat colors.
+	void replay(graphics_backend& pBackend, const framebuffer::ptr& pFramebuffer,
+		const std::vector<const texture*>& pTextures = {}) const;
+};
+
+// Wraps another backend and keeps track of everything that is drawn with it.
+class recording_backend :
+	public graphics_backend
+{
+public:
+	recording_backend(const graphics_backend::ptr& pBackend);
+
+	virtual void initialize() override;
+	virtual void render_batch(const framebuffer::ptr& mFramebuffer, const math::mat44& pProjection, const render_batch_2d& pBatch) override;
+	virtual framebuffer::ptr create_framebuffer() override;
+	virtual texture_impl::ptr create_texture_impl() override;
+	virtual texture_impl::ptr create_immediate_texture_impl() override;
+	virtual bool supports_instancing() const override;
+	virtual retained_geometry::ptr create_retained_geometry() override;
+	virtual void begin_layer(std::string_view pName) override;
+	virtual void process_uploads() override;
+	virtual void set_upload_budget(std::size_t pBytes) override;
+
+	const graphics_backend::ptr& get_wrapped_backend() const noexcept
+	{
+		return mBackend;
+	}
+
+	// Everything drawn between these counts as one frame.
+	void begin_frame();
+	void end_frame();
+
+	const frame_draw_stats& get_last_frame_stats() const noexcept
+	{
+		return mLast_frame;
+	}
+
+	// Copy every batch of the next frame. The result is
+	// available from get_last_capture() once the frame ends.
+	void capture_next_frame() noexcept
+	{
+		mCapture_requested = true;
+	}
+
+	const std::optional<captured_frame>& get_last_capture() const noexcept
+	{
+		return mLast_capture;
+	}
+
+	// Append the stats of every frame to a file as a line of json.
+	// An empty path stops logging.
+	void set_stats_log(const std::string& pPath);
+
+private:
+	draw_stats& get_current_layer_stats();
+	void capture_batch(const math::mat44& pProjection, const render_batch_2d& pBatch);
+
+private:
+	graphics_backend::ptr mBackend;
+
+	frame_draw_stats mCurrent_frame;
+	frame_draw_stats mLast_frame;
+	std::size_t mCurrent_layer{ 0 };
+	const texture* mLast_texture = nullptr;
+	// Bytes uploaded by retained geometry since the last batch.
+	std::shared_ptr<std::size_t> mRetained_bytes = std::make_shared<std::size_t>(0);
+
+	bool mCapture_requested{ false };
+	std::optional<captured_frame> mCapture;
+	std::optional<captured_frame> mLast_capture;
+	std::unordered_map<const texture*, int> mCapture_textures;
+
+	std::ofstream mStats_log;
+};
+
+} // namespace wge::graphics
@@ -4,9 +4,13 @@
 #include <wge/graphics/color.hpp>
 #include <wge/graphics/texture.hpp>
 #include <wge/math/rect.hpp>
+#include <wge/math/aabb.hpp>
 #include <wge/graphics/color.hpp>
+#include <wge/util/span.hpp>
 
 #include <vector>
+#include <memory>
+#include <cstdint>
 
 namespace wge::graphics
 {
@@ -23,6 +27,108 @@ struct vertex_2d
 	color color{ 1, 1, 1, 1 };
 };
 
+// Convert a float in the range [0, 1] to a normalized 16-bit integer.
+inline std::uint16_t pack_unorm16(float pValue) noexcept
+{
+	return static_cast<std::uint16_t>(math::clamp(pValue, 0.f, 1.f) * 65535.f + 0.5f);
+}
+
+inline float unpack_unorm16(std::uint16_t pValue) noexcept
+{
+	return static_cast<float>(pValue) / 65535.f;
+}
+
+// Compact form of vertex_2d used for uploading to the gpu.
+// The uv is stored as normalized 16-bit integers and the color as
+// normalized 8-bit integers so each vertex is only 16 bytes (half of vertex_2d).
+// UVs are clamped to the range [0, 1].
+struct packed_vertex_2d
+{
+	using uv_type = std::uint16_t;
+
+	math::vec2 position;
+	uv_type uv[2] = { 0, 0 };
+	color8 color{ 255, 255, 255, 255 };
+
+	packed_vertex_2d() noexcept = default;
+	explicit packed_vertex_2d(const vertex_2d& pVertex) noexcept :
+		position(pVertex.position),
+		color(pVertex.color)
+	{
+		set_uv(pVertex.uv);
+	}
+
+	void set_uv(const math::vec2& pUV) noexcept
+	{
+		uv[0] = pack_unorm16(pUV.x);
+		uv[1] = pack_unorm16(pUV.y);
+	}
+
+	math::vec2 get_uv() const noexcept
+	{
+		return{ unpack_unorm16(uv[0]), unpack_unorm16(uv[1]) };
+	}
+
+	// Convert back to the full vertex.
+	vertex_2d unpack() const noexcept
+	{
+		vertex_2d result;
+		result.position = position;
+		result.uv = get_uv();
+		result.color = color;
+		return result;
+	}
+};
+static_assert(sizeof(packed_vertex_2d) == 16, "packed_vertex_2d should be 16 bytes");
+
+// Interface for geometry that stays on the gpu between frames.
+// Only needs to be updated when the geometry actually changes.
+class retained_geometry
+{
+public:
+	using ptr = std::shared_ptr<retained_geometry>;
+	virtual ~retained_geometry() {}
+	// Replace the contents of the buffers. Indexes are always triangles.
+	virtual void update(util::span<const packed_vertex_2d> pVertices, util::span<const unsigned int> pIndexes) = 0;
+	virtual std::size_t get_vertex_count() const = 0;
+	virtual std::size_t get_index_count() const = 0;
+	// Copy the contents back out for debugging tools. Slow. Returns
+	// false if the backend can't read its buffers.
+	virtual bool read_back(std::vector<packed_vertex_2d>&, std::vector<unsigned int>&) const
+	{
+		return false;
+	}
+};
+
+// Describes a single sprite for the instanced rendering path.
+// The vertex shader expands a unit quad from this so the cpu only
+// needs to fill out one of these per sprite.
+// Transforms are applied in the same order as math::transform
+// (minus the shear).
+struct sprite_instance_2d
+{
+	// Position of the origin in world units.
+	math::vec2 position;
+	math::vec2 scale{ 1, 1 };
+	// Size of the quad in world units.
+	math::vec2 size;
+	// Offset of the origin from the top-left corner of the quad in world units.
+	math::vec2 anchor;
+	// UV rect of the frame stored as min.x, min.y, max.x, max.y.
+	std::uint16_t uv_rect[4] = { 0, 0, 0, 0 };
+	// Rotation in radians.
+	float rotation{ 0 };
+	color8 color{ 255, 255, 255, 255 };
+
+	void set_uv_rect(const math::aabb& pUV) noexcept
+	{
+		uv_rect[0] = pack_unorm16(pUV.min.x);
+		uv_rect[1] = pack_unorm16(pUV.min.y);
+		uv_rect[2] = pack_unorm16(pUV.max.x);
+		uv_rect[3] = pack_unorm16(pUV.max.y);
+	}
+};
+
 enum class primitive_type
 {
 	triangles,
@@ -48,12 +154,29 @@ struct render_batch_2d
 	std::vector<unsigned int> indexes;
 	std::vector<vertex_2d> vertices;
 
+	// When this is not empty, the batch is drawn with the instanced
+	// path and the vertices/indexes are ignored.
+	// Only supported if the backend reports supports_instancing().
+	// The memory is owned by whoever made the batch (normally the renderer's frame arena).
+	util::span<const sprite_instance_2d> instances;
+
+	// Indirect sources point to memory owned by someone else, like
+	// the renderer's frame arena or component storage. They are already
+	// packed so they can be uploaded without any conversion.
 	bool use_indirect_source = false;
 	util::span<const unsigned int> indexes_indirect;
-	util::span<const vertex_2d> vertices_indirect;
+	util::span<const packed_vertex_2d> vertices_indirect;
+
+	// When set, the geometry already on the gpu is drawn instead
+	// and nothing is uploaded.
+	const retained_geometry* retained = nullptr;
 
 	bool empty() const noexcept
 	{
+		if (retained)
+			return retained->get_index_count() == 0;
+		if (!instances.empty())
+			return false;
 		return (!use_indirect_source && indexes.empty() && vertices.empty()) ||
 			(use_indirect_source && indexes_indirect.empty() && vertices_indirect.empty());
 	}
@@ -61,7 +184,7 @@ struct render_batch_2d
 
 struct quad_vertices
 {
-	vertex_2d corners[4];
+	packed_vertex_2d corners[4];
 
 	void set_rect(const math::rect& pRect)
 	{
@@ -73,10 +196,10 @@ struct quad_vertices
 
 	void set_uv(const math::rect& pRect)
 	{
-		corners[0].uv = pRect.get_corner(0);
-		corners[1].uv = pRect.get_corner(1);
-		corners[2].uv = pRect.get_corner(2);
-		corners[3].uv = pRect.get_corner(3);
+		corners[0].set_uv(pRect.get_corner(0));
+		corners[1].set_uv(pRect.get_corner(1));
+		corners[2].set_uv(pRect.get_corner(2));
+		corners[3].set_uv(pRect.get_corner(3));
 	}
 };
 
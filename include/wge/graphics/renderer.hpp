@@ -1,6 +1,8 @@
 #pragma once
 
 #include <GL/glew.h>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include <wge/math/aabb.hpp>
@@ -13,52 +15,90 @@
 #include <wge/core/scene.hpp>
 #include <wge/graphics/sprite_component.hpp>
 #include <wge/graphics/framebuffer.hpp>
+#include <wge/util/frame_arena.hpp>
+#include <wge/util/thread_pool.hpp>
 
 namespace wge::graphics
 {
 
 class framebuffer;
 
-class batch_builder
+class graphics;
+
+// Culling results of a single layer.
+struct layer_render_stats
 {
-public:
+	std::string name;
+	// Sprites that made it into a batch.
+	std::size_t sprites_drawn{ 0 };
+	// Sprites outside of the view that were skipped.
+	std::size_t sprites_culled{ 0 };
+	// Texture changes between consecutive sprites.
+	std::size_t texture_switches{ 0 };
+	// Texture changes avoided because the sprites shared an atlas page.
+	std::size_t texture_switches_saved{ 0 };
+	// Sprites that reused their vertices from the last frame.
+	std::size_t sprites_reused{ 0 };
+};
 
-	// TODO: Add ability to draw to several framebuffers for post-processing
-	//void set_framebuffer(const std::string& pName);
+struct tilemap_chunk;
 
-	void set_texture(const texture& pTexture) noexcept
+// Draw commands for a single layer.
+// Building one never touches the graphics backend so layers can be built
+// on worker threads. The thread that owns the graphics context then
+// replays them in order with renderer::submit.
+class render_command_list
+{
+public:
+	// Add a batch to be rendered
+	void push_batch(render_batch_2d&& pBatch)
 	{
-		mBatch.rendertexture = &pTexture;
+		mBatches.push_back(std::move(pBatch));
 	}
 
-	// Add 4 vertices as a quad. Returns the starting index in the vertices
-	// member of the batch.
-	std::size_t add_quad(util::span<vertex_2d> pBuffer);
+	// Memory for render data. It lives until the renderer starts the next frame.
+	util::frame_arena& get_arena() noexcept
+	{
+		return mArena;
+	}
 
-	render_batch_2d finalize() noexcept
+	const layer_render_stats& get_stats() const noexcept
 	{
-		return std::move(mBatch);
+		return mStats;
 	}
 
+	// Throw away all the commands. Memory is kept for the next build and
+	// the arena is left alone since it is reset once per frame.
+	void clear();
+
 private:
-	render_batch_2d mBatch;
-};
+	friend class renderer;
 
-class graphics;
+	math::mat44 mProjection_matrix;
+	// Kept with the commands so the renderer's framebuffer can be
+	// changed while the list is submitted on another thread.
+	framebuffer::ptr mFramebuffer;
+	// Cleared every build but the capacity is kept to avoid reallocating.
+	std::vector<render_batch_2d> mBatches;
+	// Tilemap chunks are drawn after the sprites. Chunks that were
+	// rebuilt get uploaded when the list is submitted.
+	std::vector<tilemap_chunk*> mTilemap_chunks;
+	const texture* mTileset_texture = nullptr;
+	// Geometry of chunks that were removed. Released during submit
+	// since only the graphics thread can destroy it.
+	std::vector<retained_geometry::ptr> mReleased_geometry;
+	util::frame_arena mArena;
+	layer_render_stats mStats;
+};
 
 class renderer
 {
 public:
-	renderer() = default;
-	renderer(graphics& pGraphics) :
-		mGraphics(&pGraphics)
-	{}
-
-	// Add a batch to be rendered
-	void push_batch(const render_batch_2d& pBatch)
-	{
-		mBatches.push_back(pBatch);
-	}
+	renderer();
+	renderer(graphics& pGraphics);
+	renderer(renderer&&) noexcept;
+	renderer& operator=(renderer&&) noexcept;
+	~renderer();
 
 	void set_view(const math::aabb& pView) noexcept;
 	void set_raw_view(const math::aabb& mAABB) noexcept;
@@ -71,10 +111,31 @@ public:
 	// Convert screen coordinates to world coordinates
 	[[nodiscard]] math::vec2 screen_to_world(const math::vec2& pVec) const noexcept;
 
-	void render_sprites(core::layer& pLayer);
-	void render_tilemap(core::layer& pLayer);
+	// Generate the draw commands of a layer. This only touches the layer
+	// and the list so several layers can be built at the same time.
+	// Not const since the layer's tilemap chunk cache lives in its components.
+	void build_layer(core::layer& pLayer, render_command_list& pList);
+	// Draw everything in a command list. Must be called from the
+	// thread that owns the graphics context.
+	void submit(render_command_list& pList);
+
+	// Builds and submits a single layer. Always finished when it returns.
 	void render_layer(core::layer& pLayer);
+	// Builds every layer in parallel then submits them in order.
+	// With threaded submission this returns as soon as the layers are
+	// built.
 	void render_scene(core::scene& pScene);
+
+	// Submit the layers of render_scene on a thread of their own so the
+	// next frame can be simulated while the backend draws. The graphics
+	// context moves to that thread during the submission so nothing else
+	// may use the backend, and layers and textures that were drawn must
+	// stay alive, until wait_for_submission returns.
+	void set_threaded_submission(bool pEnabled);
+	bool is_threaded_submission() const noexcept;
+	// Block until the last frame is submitted and the context is back on
+	// this thread. Rendering again does this first.
+	void wait_for_submission();
 	void update_animations(core::scene& pScene, float pDelta);
 
 	// Set the current frame buffer to render to
@@ -100,18 +161,58 @@ public:
 	float get_pixel_per_unit_sq() const noexcept;
 	float get_pixel_scale() const noexcept;
 
+	// Stats of the last layer built. They are ready before it is submitted.
+	const layer_render_stats& get_last_layer_stats() const noexcept
+	{
+		return mLast_layer_stats;
+	}
+
+	// Heap allocations made by the arenas of every command list so far.
+	// This stops growing once the lists have reached their working size.
+	std::size_t get_arena_allocation_count() const noexcept
+	{
+		std::size_t count = 0;
+		for (auto& i : mCommand_lists)
+			count += i.mArena.get_heap_allocation_count();
+		return count;
+	}
+
+	// Stats of every layer drawn by the last call to render_scene
+	// or of the single layer drawn by render_layer.
+	const std::vector<layer_render_stats>& get_scene_stats() const noexcept
+	{
+		return mScene_stats;
+	}
+
 private:
+	void build_sprites(core::layer& pLayer, render_command_list& pList);
+	void build_tilemap(core::layer& pLayer, render_command_list& pList);
+
+	// Work that has to happen once on the graphics thread before any
+	// layer is built, like repacking the atlas so the builds see its
+	// final uvs, uploading queued textures and resetting the arenas.
+	void begin_frame();
+
 	// Sort the batches so then the ones with greater depth are
 	// farther in the background and less depth is closer to the
 	// forground.
-	void sort_batches();
+	static void sort_batches(std::vector<render_batch_2d>& pBatches);
+
+	void reset_layer_stats(core::layer& pLayer, layer_render_stats& pStats) const;
 
 private:
+	class submission_thread;
+
 	graphics* mGraphics = nullptr;
 	math::aabb mRender_view;
 	framebuffer::ptr mFramebuffer;
-	math::mat44 mProjection_matrix;
-	std::vector<render_batch_2d> mBatches;
+	// One list for each layer. They are reused every frame.
+	std::vector<render_command_list> mCommand_lists;
+	std::vector<core::layer*> mScene_layers;
+	layer_render_stats mLast_layer_stats;
+	std::vector<layer_render_stats> mScene_stats;
+	// nullptr unless threaded submission is enabled.
+	std::unique_ptr<submission_thread> mSubmission_thread;
 };
 
 } // namespace wge::graphics
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <wge/graphics/framebuffer.hpp>
+#include <wge/graphics/image.hpp>
+
+namespace wge::graphics
+{
+
+// A framebuffer that lives in regular memory. Used by the software backend.
+class software_framebuffer :
+	public framebuffer
+{
+public:
+	software_framebuffer() = default;
+	software_framebuffer(int pWidth, int pHeight)
+	{
+		resize(pWidth, pHeight);
+	}
+
+	virtual void resize(int pWidth, int pHeight) override
+	{
+		if (pWidth != get_width() || pHeight != get_height())
+			mImage = image(math::ivec2{ pWidth, pHeight });
+	}
+
+	virtual void clear(const color& pColor = { 0, 0, 0, 1 }) override
+	{
+		mImage.fill(color8{ pColor });
+	}
+
+	virtual int get_width() const override
+	{
+		return mImage.get_width();
+	}
+
+	virtual int get_height() const override
+	{
+		return mImage.get_height();
+	}
+
+	// The rendered pixels. Row 0 is the top of the render view.
+	const image& get_image() const noexcept
+	{
+		return mImage;
+	}
+
+	image& get_image() noexcept
+	{
+		return mImage;
+	}
+
+private:
+	image mImage;
+};
+
+} // namespace wge::graphics
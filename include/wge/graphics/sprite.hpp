@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <optional>
 
 #include <wge/util/json_helpers.hpp>
@@ -7,6 +9,7 @@
 #include <wge/math/aabb.hpp>
 #include <wge/graphics/image.hpp>
 #include <wge/graphics/texture.hpp>
+#include <wge/graphics/texture_atlas.hpp>
 
 namespace wge::graphics
 {
@@ -20,6 +23,11 @@ public:
 	static constexpr int padding = 1;
 
 public:
+	virtual ~sprite()
+	{
+		if (mAtlas)
+			mAtlas->remove(this);
+	}
 
 	struct frame_info
 	{
@@ -43,23 +51,99 @@ public:
 		}
 	};
 
+	// Everything needed to draw or animate a frame, resolved ahead of time
+	// so the per frame work doesn't have to.
+	struct frame_geometry
+	{
+		// In the texture returned by get_texture().
+		math::aabb uv;
+		// The corners of the frame in pixels relative to its anchor.
+		math::aabb quad;
+		float duration{ 0 };
+	};
+
 	virtual void load()
 	{
 		auto image_filepath = get_location()->get_autonamed_file(".png").string();
-		if (!mImage.load_file(image_filepath))
+		auto loaded = std::make_shared<image>();
+		if (!loaded->load_file(image_filepath))
 			throw std::runtime_error(
 				fmt::format("Could not load image from \"{}\". {}",
-					image_filepath, mImage.get_error()));
-		mTexture.set_image(mImage);
+					image_filepath, loaded->get_error()));
+
+		mImage_size = loaded->get_size();
+
+		// Pack the whole strip into the atlas. Reloading replaces the old one.
+		mAtlas_region = atlas_region{};
+		if (mAtlas)
+		{
+			mAtlas->insert(this, *loaded, [this](const atlas_region& pRegion)
+			{
+				mAtlas_region = pRegion;
+				mAtlas_region.dropped_pixels = nullptr;
+				// Dropped from the atlas so it has to draw from its own texture now.
+				// The atlas hands back the pixels so this never touches the file
+				// while it is repacking during a frame.
+				if (pRegion.dropped_pixels)
+					update_source_texture(std::make_shared<const image>(*pRegion.dropped_pixels));
+				update_frame_table();
+			});
+		}
+
+		// Atlased sprites are drawn from the page so only
+		// upload the strip when it has to be drawn on its own.
+		update_source_texture(std::move(loaded));
 
 		// mAabb_collision was default initialized so we must give it a useful value.
 		if (mAabb_collision.min == mAabb_collision.max)
 			set_aabb_collision_to_image_size();
+
+		update_frame_table();
 	}
 
+	// Only used if the sprite isn't in an atlas.
 	void set_texture_implementation(texture_impl::ptr pImpl)
 	{
-		mTexture.set_implementation(pImpl);
+		mTexture_impl = std::move(pImpl);
+		mTexture.set_implementation(is_in_atlas() ? texture_impl::ptr{} : mTexture_impl);
+	}
+
+	// Set before loading.
+	void set_residency(image_residency pResidency) noexcept
+	{
+		mTexture.set_residency(pResidency);
+	}
+
+	// Get the pixels of the whole strip. They are loaded from
+	// the file again if the texture didn't keep them.
+	std::shared_ptr<const image> get_image() const
+	{
+		if (const auto& resident = mTexture.get_image())
+			return resident;
+		auto loaded = std::make_shared<image>();
+		if (!loaded->load_file(get_location()->get_autonamed_file(".png").string()))
+			return{};
+		return loaded;
+	}
+
+	// Frames will be rendered from this atlas when set. The sprite
+	// is packed into it when loaded.
+	void set_atlas(texture_atlas* pAtlas) noexcept
+	{
+		mAtlas = pAtlas;
+	}
+
+	// Changes every time the frame table is rebuilt. Anything
+	// derived from the frames can compare this to know when to update.
+	// Unique across all sprites so it also tells different sprites apart.
+	std::uint64_t get_frame_table_version() const noexcept
+	{
+		return mFrame_table_version;
+	}
+
+	bool is_in_atlas() const noexcept
+	{
+		return mAtlas_region.page_texture != nullptr;
 	}
 
 	std::size_t get_frame_count() const noexcept
@@ -67,22 +151,22 @@ public:
 		return mFrames.size();
 	}
 
+	// Frames that don't exist use the defaults of the sprite.
+	const frame_geometry& get_frame_geometry(std::size_t pFrame) const noexcept
+	{
+		return pFrame < mFrame_table.size() ? mFrame_table[pFrame] : mDefault_frame;
+	}
+
 	float get_frame_duration(std::size_t pFrame) const noexcept
 	{
 		assert(pFrame < mFrames.size());
-		if (!mFrames.empty() && mFrames[pFrame].duration.has_value())
-			return mFrames[pFrame].duration.value();
-		else
-			return mFrame_duration;
+		return get_frame_geometry(pFrame).duration;
 	}
 
 	math::vec2 get_frame_anchor(std::size_t pFrame) const noexcept
 	{
 		assert(pFrame < mFrames.size());
-		if (!mFrames.empty() && mFrames[pFrame].anchor.has_value())
-			return mFrames[pFrame].anchor.value();
-		else
-			return mAnchor;
+		return math::vec2{ 0, 0 } - get_frame_geometry(pFrame).quad.min;
 	}
 
 	math::aabb get_frame_aabb(std::size_t pFrame) const noexcept
@@ -95,18 +179,29 @@ public:
 		return result;
 	}
 
+	// Get the uv of the whole strip in the texture returned by get_texture().
+	math::aabb get_uv() const noexcept
+	{
+		return is_in_atlas() ? mAtlas_region.uv : math::aabb{ 0.f, 0.f, 1.f, 1.f };
+	}
+
+	// Size of the whole strip in pixels.
+	math::ivec2 get_image_size() const noexcept
+	{
+		return mImage_size;
+	}
+
+	// Get the uv of a frame in the texture returned by get_texture().
 	math::aabb get_frame_uv(std::size_t pFrame) const noexcept
 	{
-		math::aabb result = get_frame_aabb(pFrame);
-		result.min /= math::vec2{ mImage.get_size() };
-		result.max /= math::vec2{ mImage.get_size() };
-		return result;
+		return get_frame_geometry(pFrame).uv;
 	}
 
-	frame_info& get_frame_info(std::size_t pFrame)
+	void set_frame_info(std::size_t pFrame, const frame_info& pInfo)
 	{
 		assert(pFrame < mFrames.size());
-		return mFrames[pFrame];
+		mFrames[pFrame] = pInfo;
+		update_frame_table();
 	}
 
 	const frame_info& get_frame_info(std::size_t pFrame) const
@@ -115,7 +210,15 @@ public:
 		return mFrames[pFrame];
 	}
 
+	// Returns the atlas page if this sprite is in an atlas.
 	const texture& get_texture() const noexcept
+	{
+		return is_in_atlas() ? *mAtlas_region.page_texture : mTexture;
+	}
+
+	// Get the texture of this sprite alone. It has no implementation
+	// while the sprite is in an atlas.
+	const texture& get_source_texture() const noexcept
 	{
 		return mTexture;
 	}
@@ -123,11 +226,13 @@ public:
 	void resize_animation(std::size_t pLength)
 	{
 		mFrames.resize(pLength);
+		update_frame_table();
 	}
 
-	void set_frame_size(const math::ivec2& pSize) noexcept
+	void set_frame_size(const math::ivec2& pSize)
 	{
 		mSize = pSize;
+		update_frame_table();
 	}
 
 	math::ivec2 get_frame_size() const noexcept
@@ -150,9 +255,10 @@ public:
 		return mAnchor;
 	}
 
-	void set_default_anchor(const math::vec2& pAnchor) noexcept
+	void set_default_anchor(const math::vec2& pAnchor)
 	{
 		mAnchor = pAnchor;
+		update_frame_table();
 	}
 
 	float get_default_duration() const noexcept
@@ -160,9 +266,10 @@ public:
 		return mFrame_duration;
 	}
 
-	void set_default_duration(float pSeconds) noexcept
+	void set_default_duration(float pSeconds)
 	{
 		mFrame_duration = pSeconds;
+		update_frame_table();
 	}
 
 	void set_loop(bool pLoop) noexcept
@@ -216,12 +323,73 @@ private:
 			"aabb_collision_box", math::aabb{ math::fvec2{ 0, 0 }, math::fvec2{ mSize } });
 		for (auto& i : pJson["frames"])
 			mFrames.push_back(frame_info::deserialize(i));
+		update_frame_table();
+	}
+
+	frame_geometry calc_frame_geometry(std::size_t pFrame, const frame_info& pInfo) const noexcept
+	{
+		frame_geometry result;
+		const math::vec2 anchor = pInfo.anchor.value_or(mAnchor);
+		result.quad = { math::vec2{ 0, 0 } - anchor, math::vec2{ mSize } - anchor };
+		result.duration = pInfo.duration.value_or(mFrame_duration);
+
+		// Nothing is loaded so there is nothing to divide by.
+		const math::vec2 image_size{ mImage_size };
+		if (image_size.x == 0 || image_size.y == 0)
+			return result;
+		result.uv = get_frame_aabb(pFrame);
+		result.uv.min /= image_size;
+		result.uv.max /= image_size;
+		if (is_in_atlas())
+		{
+			// Remap into the region of the atlas page.
+			const math::vec2 region_size = mAtlas_region.uv.max - mAtlas_region.uv.min;
+			result.uv.min = mAtlas_region.uv.min + result.uv.min * region_size;
+			result.uv.max = mAtlas_region.uv.min + result.uv.max * region_size;
+		}
+		return result;
+	}
+
+	// Give the pixels to the source texture. Its implementation is only
+	// set when the sprite isn't atlased so nothing gets uploaded twice.
+	void update_source_texture(std::shared_ptr<const image> pImage)
+	{
+		mTexture.set_implementation({});
+		if (is_in_atlas() && mTexture.get_residency() == image_residency::discard)
+			pImage.reset();
+		mTexture.set_image(std::move(pImage));
+		if (!is_in_atlas())
+			mTexture.set_implementation(mTexture_impl);
+	}
+
+	// Must be called whenever anything a frame depends on changes.
+	void update_frame_table()
+	{
+		mDefault_frame = calc_frame_geometry(0, frame_info{});
+		mFrame_table.resize(mFrames.size());
+		for (std::size_t i = 0; i < mFrames.size(); i++)
+			mFrame_table[i] = calc_frame_geometry(i, mFrames[i]);
+		mFrame_table_version = next_frame_table_version();
+	}
+
+	// A sprite reloaded at the address of an old one must not
+	// match anything cached from the old one so the counter is shared.
+	static std::uint64_t next_frame_table_version() noexcept
+	{
+		static std::atomic<std::uint64_t> counter{ 0 };
+		return ++counter;
 	}
 
 private:
 	texture mTexture;
-	image mImage;
+	texture_impl::ptr mTexture_impl;
+	math::ivec2 mImage_size;
+	texture_atlas* mAtlas = nullptr;
+	atlas_region mAtlas_region;
 	std::vector<frame_info> mFrames;
+	std::vector<frame_geometry> mFrame_table;
+	frame_geometry mDefault_frame;
+	std::uint64_t mFrame_table_version{ next_frame_table_version() };
 	float mFrame_duration = 0;
 	math::ivec2 mSize;
 	math::vec2 mAnchor;
@@ -347,7 +515,7 @@ public:
 		{
 			if (is_first_frame() && mTimer == 0)
 				mIs_beginning_animation = true;
-			if (mTimer >= mSprite->get_frame_duration(mFrame_index))
+			if (mTimer >= mSprite->get_frame_geometry(mFrame_index).duration)
 			{
 				mIs_new_frame = true;
 				advance_frame();
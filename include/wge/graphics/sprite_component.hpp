@@ -7,11 +7,12 @@
 #include <wge/math/vector.hpp>
 #include <wge/math/transform.hpp>
 #include <wge/graphics/sprite.hpp>
+#include <wge/graphics/render_batch_2d.hpp>
 
 namespace wge::graphics
 {
 
-class renderer;
+class render_command_list;
 
 class sprite_component
 {
@@ -22,8 +23,15 @@ public:
 		mController(pSprite)
 	{}
 
-	// Creates a batch
-	void create_batch(math::transform& pTransform, renderer& pRenderer);
+	// Creates a batch and adds it to the list.
+	// The transformed vertices are kept and reused until the transform,
+	// frame, or sprite changes. Returns true if they were reused.
+	bool create_batch(const math::transform& pTransform, float pPixel_scale, render_command_list& pList);
+	// Fills out an instance for the instanced rendering path.
+	// Returns the texture the instance should be drawn with or nullptr
+	// if there is nothing to draw.
+	// Shear is not supported. Use create_batch for sheared transforms.
+	const texture* create_instance(const math::transform& pTransform, float pPixel_scale, sprite_instance_2d& pInstance);
 
 	// Set the offset of the image in pixels
 	void set_offset(const math::vec2& pOffset) noexcept;
@@ -40,6 +48,12 @@ public:
 		return mLocal_aabb;
 	}
 
+	// Calculates the world space aabb of the current frame.
+	// The result is cached and only recalculated when the transform,
+	// frame, sprite or pixel scale change. Checking that is a handful of
+	// compares so culling stays a flat pass over the sprite storage.
+	const math::aabb& update_world_aabb(const math::transform& pTransform, float pPixel_scale);
+
 	sprite_controller& get_controller() noexcept
 	{
 		return mController;
@@ -50,10 +64,31 @@ public:
 		return mController;
 	}
 
+private:
+	math::aabb calc_local_aabb(std::size_t pFrame, float pPixel_scale) const;
+	bool is_vertex_cache_valid(const math::transform& pTransform, float pPixel_scale) const noexcept;
+
 private:
 	sprite_controller mController;
 	math::aabb mLocal_aabb;
 	math::vec2 mOffset;
+
+	// Cached world aabb and the values it was calculated from.
+	math::aabb mWorld_aabb;
+	math::transform mWorld_aabb_transform;
+	std::uint64_t mWorld_aabb_sprite_version{ 0 };
+	std::size_t mWorld_aabb_frame{ 0 };
+	float mWorld_aabb_pixel_scale{ 0 };
+	bool mWorld_aabb_valid{ false };
+
+	// Vertices of the last batch and the values they were transformed with.
+	packed_vertex_2d mCached_vertices[4];
+	math::transform mCached_transform;
+	// Unique across sprites so it identifies the sprite as well.
+	std::uint64_t mCached_sprite_version{ 0 };
+	std::size_t mCached_frame{ 0 };
+	float mCached_pixel_scale{ 0 };
+	bool mCached_vertices_valid{ false };
 };
 
 } // namespace wge::graphics
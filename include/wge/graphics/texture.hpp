@@ -19,6 +19,17 @@ public:
 	virtual bool is_smooth() const = 0;
 };
 
+// What a texture does with its pixels once the implementation has them.
+// This only covers the texture itself. Atlas pages keep their own copy
+// of every packed image, see atlas_stats::cpu_bytes.
+enum class image_residency
+{
+	// Nothing is kept. get_image() returns nullptr.
+	discard,
+	// One copy is kept and shared with anyone who asks for it.
+	keep,
+};
+
 class texture
 {
 public:
@@ -27,7 +38,15 @@ public:
 
 	void set_image(image&& pImage);
 	void set_image(const image& pImage);
-	const image& get_image() const noexcept { return mImage; }
+	// Shares the image instead of copying it.
+	void set_image(std::shared_ptr<const image> pImage);
+	// nullptr if the pixels were discarded or never set.
+	const std::shared_ptr<const image>& get_image() const noexcept { return mImage; }
+
+	// Pixels are only discarded if there is an implementation to
+	// give them to first. Discarded pixels can't be brought back.
+	void set_residency(image_residency pResidency) noexcept;
+	image_residency get_residency() const noexcept;
 
 	// Get width of texture in pixels
 	int get_width() const noexcept;
@@ -52,7 +71,9 @@ private:
 	filesystem::path mPath;
 	texture_impl::ptr mImpl;
 	bool mSmooth{ false };
-	image mImage;
+	image_residency mResidency{ image_residency::keep };
+	math::ivec2 mSize;
+	std::shared_ptr<const image> mImage;
 };
 
 } // namespace wge::graphics
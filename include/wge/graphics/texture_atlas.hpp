@@ -0,0 +1,123 @@
+#pragma once
+
+#include <wge/math/aabb.hpp>
+#include <wge/math/vector.hpp>
+#include <wge/graphics/image.hpp>
+#include <wge/graphics/texture.hpp>
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace wge::graphics
+{
+
+class graphics_backend;
+
+// Where an image ended up in the atlas.
+struct atlas_region
+{
+	// The page texture. nullptr if the image isn't in the atlas.
+	const texture* page_texture = nullptr;
+	// UV rect of the image in the page texture.
+	math::aabb uv;
+	// Set when the image was dropped from the atlas so the owner
+	// can draw it on its own without loading it again.
+	// Only valid during the callback.
+	const image* dropped_pixels = nullptr;
+};
+
+struct atlas_settings
+{
+	// Size of each page in pixels.
+	math::ivec2 page_size{ 2048, 2048 };
+	// Empty pixels between each image.
+	int padding{ 2 };
+};
+
+struct atlas_stats
+{
+	std::size_t page_count{ 0 };
+	std::size_t image_count{ 0 };
+	// Ratio of the page area that is used by images. From 0 to 1.
+	float occupancy{ 0 };
+	// Pages keep their pixels on the cpu so they can be repacked.
+	// This is the memory they use regardless of the image residency.
+	std::size_t cpu_bytes{ 0 };
+};
+
+// Packs many images into a few large textures so they can be
+// drawn without switching textures.
+// Images are packed incrementally as they are inserted. Removing an
+// image only marks its page. Marked pages are repacked by update_textures()
+// or when an insert doesn't fit anywhere else.
+class texture_atlas
+{
+public:
+	// Called when an image is placed or moved in the atlas.
+	using region_callback = std::function<void(const atlas_region&)>;
+
+	texture_atlas();
+	texture_atlas(const atlas_settings& pSettings);
+	~texture_atlas();
+
+	texture_atlas(const texture_atlas&) = delete;
+	texture_atlas& operator=(const texture_atlas&) = delete;
+
+	// Textures for new pages are created from this backend.
+	void set_graphics_backend(const std::shared_ptr<graphics_backend>& pBackend);
+
+	// Changing the settings repacks everything.
+	void set_settings(const atlas_settings& pSettings);
+	const atlas_settings& get_settings() const noexcept
+	{
+		return mSettings;
+	}
+
+	// Add or replace the image associated with a key.
+	// Returns false if the image is too big for a page. pOn_moved is called
+	// immediately and every time the image moves to a different spot.
+	bool insert(const void* pKey, const image& pImage, region_callback pOn_moved);
+	// Remove an image. Its space is reclaimed the next time its page is repacked.
+	void remove(const void* pKey);
+	bool contains(const void* pKey) const noexcept;
+
+	// Repack pages that lost images and upload any pages
+	// that changed since the last call.
+	void update_textures();
+
+	atlas_stats get_stats() const noexcept;
+
+private:
+	struct page;
+	struct entry
+	{
+		std::size_t page{ 0 };
+		math::ivec2 position, size;
+		region_callback on_moved;
+	};
+
+	// Try to fit a rect in an existing page or create a new one.
+	// Returns false if it will never fit.
+	bool allocate(entry& pEntry);
+	// Repack every page that had an image removed.
+	// Returns true if anything was repacked.
+	bool repack_pending();
+	// Images that no longer fit are added to pOverflow.
+	void repack_page(std::size_t pPage, std::vector<std::pair<const void*, entry*>>& pEntries,
+		std::vector<std::pair<const void*, image>>& pOverflow);
+	void repack_all();
+	void notify(const entry& pEntry) const;
+	static void notify_dropped(const region_callback& pCallback, const image& pPixels);
+
+	page& create_page();
+
+private:
+	atlas_settings mSettings;
+	std::shared_ptr<graphics_backend> mBackend;
+	std::vector<std::unique_ptr<page>> mPages;
+	std::unordered_map<const void*, entry> mEntries;
+};
+
+} // namespace wge::graphics
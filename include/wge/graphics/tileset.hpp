@@ -20,6 +20,24 @@ public:
 		mTexture.set_image(std::move(tsimage));
 	}
 
+	// Set before loading.
+	void set_residency(image_residency pResidency) noexcept
+	{
+		mTexture.set_residency(pResidency);
+	}
+
+	// Get the pixels of the tileset. They are loaded from
+	// the file again if the texture didn't keep them.
+	std::shared_ptr<const image> get_image() const
+	{
+		if (const auto& resident = mTexture.get_image())
+			return resident;
+		auto loaded = std::make_shared<image>();
+		if (!loaded->load_file(get_location()->get_autonamed_file(".png").string()))
+			return{};
+		return loaded;
+	}
+
 	virtual json serialize_data() const override
 	{
 		return json{
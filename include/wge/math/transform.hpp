@@ -51,6 +51,10 @@ public:
 	// Same as this = apply_to(pTransform)
 	transform& operator *= (const transform& pTransform) noexcept;
 
+	// Compares every value exactly.
+	bool operator == (const transform& pTransform) const noexcept;
+	bool operator != (const transform& pTransform) const noexcept;
+
 	operator math::mat33() const noexcept;
 
 	std::string to_string() const;
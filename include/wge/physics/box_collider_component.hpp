@@ -33,8 +33,9 @@ public:
 	void set_anchor(math::vec2 pRatio);
 	math::vec2 get_anchor() const;
 
-	// Update the shape in the fixture (if it exists)
-	void update_current_shape(const math::vec2& pScale);
+	// Update the shape in the fixture (if it exists). Nothing is done unless
+	// the settings or the rounded scale changed. Returns true if the shape was rebuilt.
+	bool update_current_shape(const math::vec2& pScale);
 
 protected:
 	// Update a shape to the current transform
@@ -47,6 +48,10 @@ private:
 	math::radians mRotation;
 	bool mIs_sensor;
 	math::vec2 mAnchor;
+	// The quantized scale of the shape in the fixture.
+	math::ivec2 mShape_scale;
+	// Set when a setting changes the shape.
+	bool mShape_dirty;
 
 	friend class physics_world;
 };
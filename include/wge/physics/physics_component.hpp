@@ -1,9 +1,12 @@
 #pragma once
 
+#include <cmath>
 #include <queue>
 
 #include <wge/core/object.hpp>
+#include <wge/math/aabb.hpp>
 #include <wge/math/vector.hpp>
+#include <wge/math/angle.hpp>
 
 class b2Body;
 class b2Fixture;
@@ -15,11 +18,41 @@ namespace wge::physics
 
 class physics_world;
 
+// Scales are rounded to this step before comparing so
+// tiny changes don't cause fixtures to be rebuilt.
+constexpr float fixture_scale_step = 1.f / 256.f;
+
+inline math::ivec2 quantize_fixture_scale(const math::vec2& pScale) noexcept
+{
+	return{
+		static_cast<int>(std::round(pScale.x / fixture_scale_step)),
+		static_cast<int>(std::round(pScale.y / fixture_scale_step)) };
+}
+
+// Everything the shape of a sprite fixture is built from.
+struct sprite_fixture_key
+{
+	math::aabb collision;
+	math::vec2 anchor;
+	math::ivec2 scale;
+
+	bool operator==(const sprite_fixture_key& pOther) const noexcept
+	{
+		return collision.min == pOther.collision.min && collision.max == pOther.collision.max
+			&& anchor == pOther.anchor && scale == pOther.scale;
+	}
+
+	bool operator!=(const sprite_fixture_key& pOther) const noexcept
+	{
+		return !(*this == pOther);
+	}
+};
+
 class sprite_fixture
 {
 private:
 	b2Fixture* mFixture;
-	math::vec2 mLast_scale;
+	sprite_fixture_key mKey;
 	friend class physics_world;
 };
 
@@ -45,7 +78,32 @@ public:
 	void set_fixed_rotation(bool pSet);
 
 private:
+	struct body_state
+	{
+		math::vec2 position;
+		math::radians rotation;
+
+		bool operator==(const body_state& pOther) const noexcept
+		{
+			return position == pOther.position && rotation == pOther.rotation;
+		}
+
+		bool operator!=(const body_state& pOther) const noexcept
+		{
+			return !(*this == pOther);
+		}
+	};
+
 	b2Body* mBody;
+	// The transform at the end of the last two ticks for interpolation.
+	body_state mPrevious, mCurrent;
+	// The transform the body and the component last agreed on.
+	// Anything else means gameplay moved the object.
+	body_state mSynced;
+	// What was last written to the transform by interpolation.
+	body_state mRendered;
+	bool mHas_state{ false };
+	bool mIs_interpolated{ false };
 	friend class physics_world;
 };
 
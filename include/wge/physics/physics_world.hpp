@@ -3,14 +3,24 @@
 #include <wge/core/object.hpp>
 #include <wge/math/vector.hpp>
 #include <wge/math/aabb.hpp>
+#include <wge/util/span.hpp>
+#include <wge/util/thread_pool.hpp>
 
 #include <Box2D/Box2D.h>
 
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
 #include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace wge::core
 {
 class layer;
+class scene;
 }
 
 namespace wge::physics
@@ -29,10 +39,141 @@ struct raycast_hit_info
 	}
 };
 
+struct ray
+{
+	math::vec2 from, to;
+};
+
+// Contacts that started or ended since the buffer was last cleared, grouped by
+// object. Both objects of a contact get an entry. Objects without an id
+// (like tilemaps) are listed as core::invalid_id but don't get an entry.
+struct contact_buffer
+{
+	using contact_map = std::unordered_map<core::object_id, std::vector<core::object_id>>;
+	contact_map begin;
+	contact_map end;
+
+	void clear() noexcept
+	{
+		begin.clear();
+		end.clear();
+	}
+
+	bool empty() const noexcept
+	{
+		return begin.empty() && end.empty();
+	}
+};
+
+// What the last step cost and what the world looked like after it.
+struct physics_stats
+{
+	// Milliseconds from b2Profile, summed over the substeps.
+	float step{ 0 };
+	float collide{ 0 };
+	float solve{ 0 };
+	float broadphase{ 0 };
+	float solve_toi{ 0 };
+
+	std::size_t bodies{ 0 };
+	std::size_t inactive_bodies{ 0 };
+	std::size_t fixtures{ 0 };
+	std::size_t contacts{ 0 };
+	std::size_t proxies{ 0 };
+	int tree_height{ 0 };
+	// Fixtures rebuilt since the last step.
+	std::size_t fixture_rebuilds{ 0 };
+
+	static const char* get_csv_header() noexcept;
+	std::string to_csv() const;
+};
+
+// Everything needed to rebuild the bodies and fixtures of a world.
+// Records are plain data stored in the same order as the world's lists.
+struct physics_snapshot
+{
+	struct body_record
+	{
+		core::object_id object_id{ core::invalid_id };
+		b2BodyType type{ b2_staticBody };
+		b2Vec2 position;
+		float angle{ 0 };
+		b2Vec2 linear_velocity;
+		float angular_velocity{ 0 };
+		float linear_damping{ 0 };
+		float angular_damping{ 0 };
+		float gravity_scale{ 1 };
+		bool awake{ true };
+		bool active{ true };
+		bool sleeping_allowed{ true };
+		bool fixed_rotation{ false };
+		bool bullet{ false };
+		// The fixtures of this body start at this index in fixtures.
+		std::uint32_t first_fixture{ 0 };
+		std::uint32_t fixture_count{ 0 };
+	};
+
+	struct fixture_record
+	{
+		core::object_id object_id{ core::invalid_id };
+		// Only circles and polygons are saved.
+		b2Shape::Type shape_type{ b2Shape::e_polygon };
+		float radius{ 0 };
+		// The center of a circle or the centroid of a polygon.
+		b2Vec2 center;
+		std::int32_t vertex_count{ 0 };
+		b2Vec2 vertices[b2_maxPolygonVertices];
+		b2Vec2 normals[b2_maxPolygonVertices];
+		float friction{ 0 };
+		float restitution{ 0 };
+		float density{ 0 };
+		bool is_sensor{ false };
+		b2Filter filter;
+	};
+
+	std::vector<body_record> bodies;
+	std::vector<fixture_record> fixtures;
+
+	std::size_t get_size_bytes() const noexcept
+	{
+		return bodies.size() * sizeof(body_record) + fixtures.size() * sizeof(fixture_record);
+	}
+};
+
+// A world and the isolated worlds of a scene's layers.
+struct scene_physics_snapshot
+{
+	physics_snapshot world;
+	// One for each layer in scene order. Empty for layers
+	// that don't have a world of their own.
+	std::vector<std::optional<physics_snapshot>> layers;
+};
+
+struct step_settings
+{
+	// A tick is split into this many world steps.
+	int substeps{ 1 };
+	int velocity_iterations{ 8 };
+	int position_iterations{ 3 };
+};
+
 class physics_world
 {
 public:
 	physics_world();
+	// The contact listener points back into the world.
+	physics_world(const physics_world&) = delete;
+	physics_world& operator=(const physics_world&) = delete;
+
+	void set_step_settings(const step_settings& pSettings) noexcept
+	{
+		mStep_settings = pSettings;
+	}
+
+	const step_settings& get_step_settings() const noexcept
+	{
+		return mStep_settings;
+	}
 
 	void set_gravity(math::vec2 pVec);
 	math::vec2 get_gravity() const;
@@ -58,37 +199,26 @@ public:
 
 	raycast_hit_info raycast_closest(const math::vec2& pA, const math::vec2& pB) const
 	{
-		// Box2d doesn't know how to handle rays with zero length
-		// so let's just return early.
-		if (pA == pB)
-			return raycast_hit_info{};
-		struct callback : b2RayCastCallback
-		{
-			raycast_hit_info hit;
-			virtual float32 ReportFixture(b2Fixture* fixture, const b2Vec2& point,
-				const b2Vec2& normal, float32 fraction) override
-			{
-				hit.hit = true;
-				hit.object_id = static_cast<core::object_id>(reinterpret_cast<std::uintptr_t>(fixture->GetUserData()));
-				hit.point = { point.x, point.y };
-				hit.normal = { normal.x, normal.y };
-				return fraction;
-			}
-		} mycallback;
-		mWorld->RayCast(&mycallback, { pA.x, pA.y }, { pB.x, pB.y });
+		const raycast_hit_info hit = find_closest_hit(pA, pB);
 
 		// Debug raycast.
 		if (mRaycast_debug_enabled && mRaycast_debugs.size() < 500){
 			raycast_debug db;
 			db.from = pA;
 			db.to = pB;
-			db.hit = mycallback.hit.hit;
-			db.point = mycallback.hit.point;
+			db.hit = hit.hit;
+			db.point = hit.point;
 			mRaycast_debugs.push_back(db);
 		}
 
-		return mycallback.hit;
+		return hit;
 	}
+
+	// Find the closest hit of every ray. Large batches are split across
+	// worker threads. The world must not be modified until this returns.
+	// pResults must be at least as large as pRays.
+	void raycast_closest(util::span<const ray> pRays, util::span<raycast_hit_info> pResults) const;
+	std::vector<raycast_hit_info> raycast_closest(util::span<const ray> pRays) const;
 	
 	template <typename Tcallable>
 	void raycast(Tcallable&& pCallable, const math::vec2& pA, const math::vec2& pB) const
@@ -142,6 +272,9 @@ public:
 		return mycallback.hit;
 	}
 
+	// Test every aabb. Same rules as the batched raycast_closest.
+	void test_aabb(util::span<const math::aabb> pAabbs, util::span<bool> pResults) const;
+
 	void clear_all()
 	{
 		b2Body* i = mWorld->GetBodyList();
@@ -155,11 +288,151 @@ public:
 
 	b2World* get_world() const;
 
-	void preupdate(core::layer& pLayer, float pSq_pixel_size, float pDelta);
-	void postupdate(core::layer& pLayer, float pDelta);
-private:
+	// Fixtures that had to be created or reshaped because
+	// their shape changed.
+	std::size_t get_fixture_rebuild_count() const noexcept
+	{
+		return mFixture_rebuilds;
+	}
+
+	void reset_fixture_rebuild_count() noexcept
+	{
+		mFixture_rebuilds = 0;
+	}
+
+	// A tick goes like this:
+	//   preupdate for every layer, step once, update_object_transforms
+	//   for every layer, gameplay, and then postupdate for every layer.
+
+	// Creates bodies and fixtures. Interpolated transforms are put back.
+	void preupdate(core::layer& pLayer, float pSq_pixel_size);
+	// Advance the whole world by one tick.
+	void step(float pDelta);
+	// Step this world and pOthers at the same time, each on its own worker.
+	// Worlds share no state of their own. Box2D's global counters are thread
+	// local and its contact registers are initialized once, so that is safe.
+	void step(float pDelta, util::span<physics_world* const> pOthers);
+
+	// Counting the fixtures means walking every body so
+	// that only happens here or when a log is open.
+	const physics_stats& get_stats() const noexcept;
+
+	// Append the stats of every step to a csv file. Once the file has
+	// pMax_rows rows it is moved to "<path>.old" and a new one is started.
+	// An empty path stops logging.
+	void set_stats_log(const std::string& pPath, std::size_t pMax_rows = 10000);
+
+	// Save the bodies that belong to objects. Tilemap collision isn't saved
+	// since it is rebuilt from the tile grid.
+	physics_snapshot snapshot() const;
+
+	// Throw away the world and rebuild it from a snapshot. Every layer of
+	// pScene that uses this world is pointed at the new bodies and has its
+	// transforms moved to match. Stepping from the same snapshot always gives
+	// the same result. Contacts start over, so a world that keeps running
+	// after snapshot() can drift from one restored from it. Use checkpoint()
+	// when the live run has to match.
+	void restore(const physics_snapshot& pSnapshot, core::scene& pScene);
+
+	// Snapshot this world and the isolated world of every layer in pScene,
+	// then restore them from the result right away. The live run continues
+	// exactly like any later restore from the result.
+	scene_physics_snapshot checkpoint(core::scene& pScene);
+	// Restore this world and the isolated layer worlds from a checkpoint.
+	void restore(const scene_physics_snapshot& pSnapshot, core::scene& pScene);
+
+	// Only bodies inside one of these regions are simulated. Moving bodies
+	// further than the margin outside every region are deactivated and
+	// come back once they are inside a region again. The margin keeps
+	// bodies near the edge from switching every tick. No regions means
+	// everything is simulated.
+	void set_activity_regions(util::span<const math::aabb> pRegions, float pMargin = 2.f)
+	{
+		mActivity_regions.assign(pRegions.begin(), pRegions.end());
+		mActivity_margin = pMargin;
+	}
+
+	void clear_activity_regions() noexcept
+	{
+		mActivity_regions.clear();
+	}
+
+	// Bodies that were deactivated for being outside the activity regions.
+	std::size_t get_inactive_body_count() const noexcept
+	{
+		return mInactive_bodies;
+	}
+
+	// The world that simulates pLayer. That is this world unless the layer
+	// has isolated_physics. Isolated worlds are created on first use with
+	// the gravity and step settings of this world.
+	physics_world& get_layer_world(core::layer& pLayer);
+	// Copy the bodies into their transforms.
 	void update_object_transforms(core::layer& pLayer);
+	// Push transforms changed by gameplay back into the bodies.
+	void postupdate(core::layer& pLayer);
+
+	// Contacts are only recorded while the world changes. Scripts get them
+	// afterwards so nothing calls into gameplay code from inside the solver.
+	const contact_buffer& get_contacts() const noexcept
+	{
+		return mContacts;
+	}
+
+	// Call once the contacts have been handed out.
+	void clear_contacts() noexcept
+	{
+		mContacts.clear();
+	}
+
+	// Move the transforms between the last two ticks for rendering.
+	// pAlpha is from 0 (the previous tick) to 1 (the last tick). They
+	// are put back by the next preupdate.
+	void interpolate(core::layer& pLayer, float pAlpha);
 
+private:
+	raycast_hit_info find_closest_hit(const math::vec2& pA, const math::vec2& pB) const
+	{
+		// Box2d doesn't know how to handle rays with zero length
+		// so let's just return early.
+		if (pA == pB)
+			return raycast_hit_info{};
+		struct callback : b2RayCastCallback
+		{
+			raycast_hit_info hit;
+			virtual float32 ReportFixture(b2Fixture* fixture, const b2Vec2& point,
+				const b2Vec2& normal, float32 fraction) override
+			{
+				hit.hit = true;
+				hit.object_id = static_cast<core::object_id>(reinterpret_cast<std::uintptr_t>(fixture->GetUserData()));
+				hit.point = { point.x, point.y };
+				hit.normal = { normal.x, normal.y };
+				return fraction;
+			}
+		} mycallback;
+		mWorld->RayCast(&mycallback, { pA.x, pA.y }, { pB.x, pB.y });
+		return mycallback.hit;
+	}
+
+	// Calls pCallback(std::size_t index) for every query in a batch.
+	template <typename Tcallback>
+	void for_each_query(std::size_t pCount, Tcallback&& pCallback) const;
+
+	void update_stats(const b2Profile& pProfile);
+	std::size_t count_fixtures() const noexcept;
+
+	// Point the components of a layer at the bodies of a restored world.
+	void relink(core::layer& pLayer);
+	// True if pLayer is simulated by this world.
+	bool is_layer_world(const core::layer& pLayer) const noexcept;
+
+	// Activate or deactivate bodies based on the activity regions.
+	void update_activity();
+
+	// Rebuild the fixtures of tilemap chunks that changed.
+	void update_tilemap_collision(core::layer& pLayer);
+
+private:
 	struct raycast_debug
 	{
 		math::vec2 from, to;
@@ -172,11 +445,53 @@ private:
 	mutable std::vector<raycast_debug> mRaycast_debugs;
 
 private:
+	class contact_listener :
+		public b2ContactListener
+	{
+	public:
+		contact_listener(contact_buffer& pBuffer) :
+			mBuffer(&pBuffer)
+		{}
+
+		virtual void BeginContact(b2Contact* pContact) override;
+		virtual void EndContact(b2Contact* pContact) override;
+
+	private:
+		contact_buffer* mBuffer;
+	};
+
 	// Unfortunately, box2d likes to have everything pointing
 	// to eachother so we have to keep its world in heap.
 	std::unique_ptr<b2World> mWorld;
+	contact_buffer mContacts;
+	std::unique_ptr<contact_listener> mContact_listener;
+	step_settings mStep_settings;
+	// Created on the first batch query or step that is large enough to need it.
+	mutable std::unique_ptr<util::thread_pool> mWorkers;
+	// Set for worlds created by get_layer_world().
+	bool mIs_isolated{ false };
+	std::size_t mFixture_rebuilds{ 0 };
+	std::vector<math::aabb> mActivity_regions;
+	float mActivity_margin{ 2.f };
+	std::size_t mInactive_bodies{ 0 };
+
+	// The fixture count is filled in lazily by get_stats().
+	mutable physics_stats mStats;
+	mutable bool mStats_fixtures_counted{ false };
+	std::size_t mLast_fixture_rebuilds{ 0 };
+	std::string mStats_log_path;
+	std::ofstream mStats_log;
+	std::size_t mStats_log_rows{ 0 };
+	std::size_t mStats_log_max_rows{ 0 };
 
 	friend class physics_component;
 };
 
+// Layer component. Layers with this are simulated in a world of their own
+// that never interacts with other layers. See physics_world::get_layer_world.
+struct isolated_physics
+{
+	std::shared_ptr<physics_world> world;
+};
+
 } // namespace wge::physics
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <wge/core/tile_grid.hpp>
+#include <wge/math/vector.hpp>
+
+#include <vector>
+
+namespace wge::physics
+{
+
+// Layer component that gives a tilemap layer collision. Every
+// tile is solid. The fixtures are built by physics_world.
+struct tilemap_collider
+{
+	float friction{ 0.2f };
+};
+
+// A rectangle of solid tiles. In tiles.
+struct tile_rect
+{
+	math::ivec2 position;
+	math::ivec2 size;
+};
+
+// Cover the tiles of a chunk with as few rectangles as possible. Rows of tiles
+// are merged first and then grown downwards while the rows below match.
+inline std::vector<tile_rect> merge_tile_rects(const core::tile_grid::chunk& pChunk)
+{
+	constexpr int size = core::tilemap_chunk_size;
+	std::vector<tile_rect> result;
+	std::array<bool, size * size> visited{};
+	const auto is_free = [&](int pX, int pY)
+	{
+		const std::size_t index = static_cast<std::size_t>(pY) * size + pX;
+		return !visited[index] && pChunk.cells[index].is_occupied();
+	};
+
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			if (!is_free(x, y))
+				continue;
+
+			int width = 1;
+			while (x + width < size && is_free(x + width, y))
+				++width;
+
+			int height = 1;
+			for (; y + height < size; height++)
+			{
+				bool full_row = true;
+				for (int i = x; i < x + width && full_row; i++)
+					full_row = is_free(i, y + height);
+				if (!full_row)
+					break;
+			}
+
+			for (int j = y; j < y + height; j++)
+				for (int i = x; i < x + width; i++)
+					visited[static_cast<std::size_t>(j) * size + i] = true;
+
+			result.push_back(tile_rect{ pChunk.position * size + math::ivec2{ x, y }, { width, height } });
+		}
+	}
+	return result;
+}
+
+} // namespace wge::physics
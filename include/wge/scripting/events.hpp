@@ -56,12 +56,13 @@ using alarm_6 = bselect<12>;
 using alarm_7 = bselect<13>;
 using alarm_8 = bselect<14>;
 
+using collision_begin = bselect<15>;
+using collision_end = bselect<16>;
+
 // Planned events
 
 // Physics Events:
-// Start collision
 // Continued Collision
-// End Collision
 
 // Sprite Events:
 // New Frame
@@ -75,7 +76,7 @@ using alarm_8 = bselect<14>;
 // Load
 // Save
 
-constexpr core::bucket bucket_count = 15;
+constexpr core::bucket bucket_count = 17;
 
 } // namespace event_selectors
 
@@ -106,6 +107,9 @@ constexpr std::array event_descriptors =
 	event_descriptor{ "alarm_6",       "Alarm 6",       u8"\uf017",  event_selector::alarm_6::bucket, "Triggered when the variable 'alarm[6]' is equal or below 0." },
 	event_descriptor{ "alarm_7",       "Alarm 7",       u8"\uf017",  event_selector::alarm_7::bucket, "Triggered when the variable 'alarm[7]' is equal or below 0." },
 	event_descriptor{ "alarm_8",       "Alarm 8",       u8"\uf017",  event_selector::alarm_8::bucket, "Triggered when the variable 'alarm[8]' is equal or below 0." },
+
+	event_descriptor{ "collision_begin", "Collision Begin", u8"\uf0e7", event_selector::collision_begin::bucket, "Triggered once per frame when the object starts touching other objects. They are listed in the variable 'collisions'." },
+	event_descriptor{ "collision_end",   "Collision End",   u8"\uf0e7", event_selector::collision_end::bucket, "Triggered once per frame when the object stops touching other objects. They are listed in the variable 'collisions'." },
 };
 
 constexpr std::size_t get_event_descriptor_index(std::size_t pBucket) noexcept
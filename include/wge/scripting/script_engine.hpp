@@ -32,6 +32,7 @@ namespace wge::physics
 {
 
 class physics_world;
+struct contact_buffer;
 
 }
 
@@ -63,11 +64,19 @@ public:
 	void register_graphics_api(graphics::camera& pDefault_camera);
 	void register_math_api();
 	void register_physics_api(physics::physics_world& pPhysics, core::scene& pScene);
+	// Physics functions use this world instead of the one given to register_physics_api
+	// until it is set back to nullptr. Used for layers that have their own world.
+	void set_layer_physics(physics::physics_world* pPhysics) noexcept
+	{
+		mLayer_physics = pPhysics;
+	}
 
 	void event_create(core::layer& pLayer);
 	void event_unique_create(core::layer& pLayer);
 	void event_preupdate(core::layer& pLayer);
 	void event_alarms(core::layer& pLayer, std::size_t pIndex);
+	// Collision Begin and Collision End. Objects in other layers are looked up in pScene.
+	void event_collisions(core::layer& pLayer, const physics::contact_buffer& pContacts, core::scene& pScene);
 	void event_update(core::layer& pLayer);
 	void event_postupdate(core::layer& pLayer);
 	void event_draw(core::layer& pLayer, float pDelta);
@@ -133,8 +142,15 @@ private:
 	std::map<core::object_id, runtime_error_info> mRuntime_errors;
 
 	core::asset_manager* mAsset_manager = nullptr;
+	physics::physics_world* mPhysics = nullptr;
+	physics::physics_world* mLayer_physics = nullptr;
 
 private:
+	physics::physics_world& get_physics() const noexcept
+	{
+		return *(mLayer_physics ? mLayer_physics : mPhysics);
+	}
+
 	void run_script(script::handle& pSource, const sol::environment& pEnv, const std::string& pEvent_name, const core::object_id& pId);
 };
 
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <wge/util/span.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace wge::util
+{
+
+// A linear allocator for data that only lives for a single frame.
+// Allocations just bump an offset and everything is released at once
+// with reset(). The memory is kept between resets so once the arena has
+// grown to fit a frame, no more heap allocations are made.
+class frame_arena
+{
+public:
+	static constexpr std::size_t default_block_size = 64 * 1024;
+
+	frame_arena(std::size_t pBlock_size = default_block_size) :
+		mBlock_size(pBlock_size)
+	{}
+
+	frame_arena(const frame_arena&) = delete;
+	frame_arena& operator=(const frame_arena&) = delete;
+	frame_arena(frame_arena&&) noexcept = default;
+	frame_arena& operator=(frame_arena&&) noexcept = default;
+
+	// Allocate pCount default constructed elements.
+	// Destructors are never called so only trivially destructible types are allowed.
+	template <typename T>
+	span<T> allocate(std::size_t pCount)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "Arena memory is released without calling destructors");
+		if (pCount == 0)
+			return{};
+		T* ptr = static_cast<T*>(allocate_bytes(sizeof(T) * pCount, alignof(T)));
+		std::uninitialized_default_construct_n(ptr, pCount);
+		return{ ptr, pCount };
+	}
+
+	// Release everything allocated since the last reset.
+	void reset()
+	{
+		// If the last frame needed more than one block, merge them so the
+		// next frame fits in one. This is the only allocation a reset makes.
+		if (mBlocks.size() > 1)
+		{
+			std::size_t total = 0;
+			for (auto& i : mBlocks)
+				total += i.size;
+			mBlocks.clear();
+			add_block(total);
+		}
+		mCurrent_block = 0;
+		mOffset = 0;
+		mBytes_used = 0;
+	}
+
+	// Amount of bytes handed out since the last reset.
+	std::size_t get_bytes_used() const noexcept
+	{
+		return mBytes_used;
+	}
+
+	// Total amount of bytes the arena is holding onto.
+	std::size_t get_capacity() const noexcept
+	{
+		std::size_t total = 0;
+		for (auto& i : mBlocks)
+			total += i.size;
+		return total;
+	}
+
+	// Amount of times the arena has gone to the heap for memory.
+	std::size_t get_heap_allocation_count() const noexcept
+	{
+		return mHeap_allocations;
+	}
+
+private:
+	struct block
+	{
+		std::unique_ptr<std::byte[]> data;
+		std::size_t size{ 0 };
+	};
+
+	void* allocate_bytes(std::size_t pSize, std::size_t pAlignment)
+	{
+		// Look for room in the current block or any of the ones after it.
+		for (; mCurrent_block < mBlocks.size(); mCurrent_block++, mOffset = 0)
+		{
+			block& current = mBlocks[mCurrent_block];
+			const std::size_t aligned = align_offset(current, mOffset, pAlignment);
+			if (aligned + pSize <= current.size)
+			{
+				mOffset = aligned + pSize;
+				mBytes_used += pSize;
+				return current.data.get() + aligned;
+			}
+		}
+
+		// Nothing fits so we need a new block.
+		add_block(std::max(mBlock_size, pSize + pAlignment));
+		mCurrent_block = mBlocks.size() - 1;
+		block& current = mBlocks.back();
+		const std::size_t aligned = align_offset(current, 0, pAlignment);
+		mOffset = aligned + pSize;
+		mBytes_used += pSize;
+		return current.data.get() + aligned;
+	}
+
+	static std::size_t align_offset(const block& pBlock, std::size_t pOffset, std::size_t pAlignment) noexcept
+	{
+		const auto address = reinterpret_cast<std::uintptr_t>(pBlock.data.get()) + pOffset;
+		const auto aligned = (address + pAlignment - 1) & ~(static_cast<std::uintptr_t>(pAlignment) - 1);
+		return pOffset + static_cast<std::size_t>(aligned - address);
+	}
+
+	void add_block(std::size_t pSize)
+	{
+		block new_block;
+		new_block.data = std::make_unique<std::byte[]>(pSize);
+		new_block.size = pSize;
+		mBlocks.push_back(std::move(new_block));
+		++mHeap_allocations;
+	}
+
+private:
+	std::size_t mBlock_size;
+	std::vector<block> mBlocks;
+	std::size_t mCurrent_block{ 0 };
+	std::size_t mOffset{ 0 };
+	std::size_t mBytes_used{ 0 };
+	std::size_t mHeap_allocations{ 0 };
+};
+
+} // namespace wge::util
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace wge::util
+{
+
+// A fixed set of worker threads that run queued jobs.
+class thread_pool
+{
+public:
+	// A plain function and its argument so queueing one never allocates.
+	// Whatever pData points to has to outlive the job.
+	struct job
+	{
+		void(*function)(void*) = nullptr;
+		void* data = nullptr;
+	};
+
+	// Uses one thread less than the hardware has since
+	// the calling thread helps out in parallel_for.
+	static std::size_t get_default_thread_count() noexcept;
+
+	thread_pool(std::size_t pThread_count = get_default_thread_count());
+	~thread_pool();
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	std::size_t get_thread_count() const noexcept
+	{
+		return mThreads.size();
+	}
+
+	// Queue a job to be run by one of the workers. The queue keeps
+	// its memory so this doesn't allocate once it has grown.
+	void push(job pJob);
+
+	// Calls pCallback(std::size_t index) for every index in [0, pCount).
+	// The calling thread takes part and this only returns once every
+	// index is done. The first exception thrown by a callback is rethrown here.
+	template <typename Tcallback>
+	void parallel_for(std::size_t pCount, Tcallback&& pCallback);
+
+private:
+	void worker();
+
+private:
+	std::vector<std::thread> mThreads;
+	// Jobs before mNext_job were already taken. Both are reset
+	// when the queue runs dry so the capacity gets reused.
+	std::vector<job> mJobs;
+	std::size_t mNext_job{ 0 };
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	bool mStopping{ false };
+};
+
+template <typename Tcallback>
+inline void thread_pool::parallel_for(std::size_t pCount, Tcallback&& pCallback)
+{
+	if (pCount == 0)
+		return;
+
+	// Not worth waking anyone for a single index.
+	if (pCount == 1 || mThreads.empty())
+	{
+		for (std::size_t i = 0; i < pCount; i++)
+			pCallback(i);
+		return;
+	}
+
+	// Everything lives on this stack frame so nothing
+	// has to be allocated for the helpers.
+	struct shared_state
+	{
+		std::remove_reference_t<Tcallback>* callback = nullptr;
+		std::size_t count{ 0 };
+		std::atomic<std::size_t> next_index{ 0 };
+		std::size_t helpers_running{ 0 };
+		std::exception_ptr exception;
+		std::mutex mutex;
+		std::condition_variable done;
+
+		void run()
+		{
+			for (std::size_t i = next_index++; i < count; i = next_index++)
+			{
+				try
+				{
+					(*callback)(i);
+				}
+				catch (...)
+				{
+					std::lock_guard lock{ mutex };
+					if (!exception)
+						exception = std::current_exception();
+				}
+			}
+		}
+	} state;
+	state.callback = &pCallback;
+	state.count = pCount;
+
+	// The state is on this stack frame so every helper has
+	// to be finished before returning, not just every index.
+	const std::size_t helper_count = std::min(mThreads.size(), pCount - 1);
+	state.helpers_running = helper_count;
+	const job helper{ [](void* pState)
+	{
+		auto& state = *static_cast<shared_state*>(pState);
+		state.run();
+		std::lock_guard lock{ state.mutex };
+		if (--state.helpers_running == 0)
+			state.done.notify_one();
+	}, &state };
+	for (std::size_t i = 0; i < helper_count; i++)
+		push(helper);
+
+	state.run();
+
+	std::unique_lock lock{ state.mutex };
+	state.done.wait(lock, [&]() { return state.helpers_running == 0; });
+	if (state.exception)
+		std::rethrow_exception(state.exception);
+}
+
+} // namespace wge::util
@@ -1,4 +1,5 @@
 #include <wge/core/engine.hpp>
+#include <wge/logging/log.hpp>
 
 #include <wge/physics/box_collider_component.hpp>
 #include <wge/physics/physics_component.hpp>
@@ -9,6 +10,8 @@
 #include <wge/core/object_resource.hpp>
 #include <wge/core/scene_resource.hpp>
 
+#include <algorithm>
+
 namespace wge::core
 {
 
@@ -26,6 +29,8 @@ engine::engine()
 	{
 		auto res = std::make_unique<graphics::sprite>();
 		res->set_texture_implementation(mGraphics.get_graphics_backend()->create_texture_impl());
+		res->set_residency(mGraphics.get_image_residency());
+		res->set_atlas(&mGraphics.get_sprite_atlas());
 		pAsset->set_resource(std::move(res));
 	});
 
@@ -34,6 +39,7 @@ engine::engine()
 	{
 		auto res = std::make_unique<graphics::tileset>();
 		res->set_texture_implementation(mGraphics.get_graphics_backend()->create_texture_impl());
+		res->set_residency(mGraphics.get_image_residency());
 		pAsset->set_resource(std::move(res));
 	});
 	mAsset_manager.register_default_resource_factory<scene_resource>("scene");
@@ -85,31 +91,96 @@ void engine::close_game()
 	mLoaded = false;
 }
 
-void engine::step()
+void engine::update(float pElapsed)
 {
-	float delta = 1.f / 60.f;
+	// Falling behind by more than this drops the extra time
+	// instead of trying to catch up forever.
+	constexpr int max_ticks_per_update = 5;
 
+	mTick_accumulator += pElapsed;
+	int ticks = 0;
+	while (mTick_accumulator >= mTick_duration && ticks < max_ticks_per_update)
+	{
+		step();
+		mTick_accumulator -= mTick_duration;
+		++ticks;
+	}
+	if (ticks == max_ticks_per_update)
+		mTick_accumulator = std::min(mTick_accumulator, mTick_duration);
+
+	const float alpha = mTick_accumulator / mTick_duration;
 	for (auto& i : mScene)
-		mPhysics.preupdate(i, mGraphics.get_pixels_per_unit_sq(), delta);
+		mPhysics.get_layer_world(i).interpolate(i, alpha);
+}
 
-	mLua_engine.update_delta(delta);
+void engine::step()
+{
+	const float delta = mTick_duration;
 
+	// Layers without a world of their own share mPhysics.
+	mIsolated_worlds.clear();
 	for (auto& i : mScene)
-		mLua_engine.event_create(i);
+	{
+		physics::physics_world& world = mPhysics.get_layer_world(i);
+		if (&world != &mPhysics)
+			mIsolated_worlds.push_back(&world);
+	}
+
+	// Bodies far from the camera are put to rest.
+	if (mPhysics_activity_range > 0)
+	{
+		math::aabb region = mDefault_camera.get_view();
+		region.min -= mPhysics_activity_range;
+		region.max += mPhysics_activity_range;
+		const math::aabb regions[] = { region };
+		mPhysics.set_activity_regions(regions);
+		for (physics::physics_world* i : mIsolated_worlds)
+			i->set_activity_regions(regions);
+	}
+	else
+	{
+		mPhysics.clear_activity_regions();
+		for (physics::physics_world* i : mIsolated_worlds)
+			i->clear_activity_regions();
+	}
+
 	for (auto& i : mScene)
-		mLua_engine.event_unique_create(i);
+		mPhysics.get_layer_world(i).preupdate(i, mGraphics.get_pixels_per_unit_sq());
+	// Every world only steps once.
+	mPhysics.step(delta, mIsolated_worlds);
 	for (auto& i : mScene)
-		mLua_engine.event_preupdate(i);
-	for (std::size_t alarm_index = 0; alarm_index < 8; alarm_index++)
+		mPhysics.get_layer_world(i).update_object_transforms(i);
+
+	mLua_engine.update_delta(delta);
+
+	// Scripts query the world of the layer they run in.
+	const auto for_each_layer = [&](auto&& pCallback)
+	{
 		for (auto& i : mScene)
-			mLua_engine.event_alarms(i, alarm_index);
-	for (auto& i : mScene)
-		mLua_engine.event_update(i);
-	for (auto& i : mScene)
-		mLua_engine.event_postupdate(i);
+		{
+			mLua_engine.set_layer_physics(&mPhysics.get_layer_world(i));
+			pCallback(i);
+		}
+		mLua_engine.set_layer_physics(nullptr);
+	};
+
+	for_each_layer([&](layer& pLayer) { mLua_engine.event_create(pLayer); });
+	for_each_layer([&](layer& pLayer) { mLua_engine.event_unique_create(pLayer); });
+	for_each_layer([&](layer& pLayer)
+	{
+		mLua_engine.event_collisions(pLayer, mPhysics.get_layer_world(pLayer).get_contacts(), mScene);
+	});
+	mPhysics.clear_contacts();
+	for (physics::physics_world* i : mIsolated_worlds)
+		i->clear_contacts();
+	for_each_layer([&](layer& pLayer) { mLua_engine.event_preupdate(pLayer); });
+	for (std::size_t alarm_index = 0; alarm_index < 8; alarm_index++)
+		for_each_layer([&](layer& pLayer) { mLua_engine.event_alarms(pLayer, alarm_index); });
+	for_each_layer([&](layer& pLayer) { mLua_engine.event_update(pLayer); });
+	for_each_layer([&](layer& pLayer) { mLua_engine.event_postupdate(pLayer); });
 
 	for (auto& i : mScene)
-		mPhysics.postupdate(i, delta);
+		mPhysics.get_layer_world(i).postupdate(i);
 }
 
 bool engine::is_loaded() const
@@ -121,6 +192,11 @@ void engine::load_assets()
 {
 	mAsset_manager.set_root_directory(mSettings.get_asset_directory());
 	mAsset_manager.load_assets();
+
+	const graphics::atlas_stats atlas = mGraphics.get_sprite_atlas().get_stats();
+	log::info("Packed {} sprites into {} atlas pages ({:.1f}% occupied, {:.1f} MB kept on the cpu)",
+		atlas.image_count, atlas.page_count, atlas.occupancy * 100.f,
+		static_cast<float>(atlas.cpu_bytes) / (1024.f * 1024.f));
 }
 
 } // namespace wge::core
@@ -16,6 +16,7 @@ const std::string& layer::get_name() const noexcept
 
 object layer::add_object()
 {
+	++mVersion;
 	object_id id = get_global_generator().get();
 	assert(!mComponent_manager.get_storage<object_info>().has(id));
 	mComponent_manager.add_component(id, object_info{});
@@ -32,6 +33,7 @@ object layer::add_object(const std::string& pName)
 
 void layer::remove_object(const object_id& pObject_id)
 {
+	++mVersion;
 	mComponent_manager.remove_object(pObject_id);
 }
 
@@ -42,6 +44,7 @@ void layer::remove_object(queue_destruction_flag, const object_id& pObject_id)
 
 void layer::remove_all_objects()
 {
+	++mVersion;
 	mComponent_manager.clear();
 }
 
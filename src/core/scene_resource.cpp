@@ -5,6 +5,7 @@
 #include <wge/scripting/script_engine.hpp>
 #include <wge/physics/physics_world.hpp>
 #include <wge/physics/physics_component.hpp>
+#include <wge/physics/tilemap_collider.hpp>
 #include <wge/scripting/events.hpp>
 #include <wge/core/instance.hpp>
 
@@ -19,18 +20,22 @@ static void serialize_scene(json& pJson, scene& pScene)
 	{
 		json this_layer;
 		this_layer["name"] = l.get_name();
+		this_layer["isolated_physics"] = l.layer_components.has<physics::isolated_physics>();
 		if (core::is_tilemap_layer(l))
 		{
 			core::tilemap_manipulator mani(l);
 			this_layer["type"] = "tilemap";
 			this_layer["tile_size"] = mani.get_tilesize();
 			this_layer["tileset"] = mani.get_tileset().get_id();
+			this_layer["collision"] = l.layer_components.has<physics::tilemap_collider>();
 			auto& tiles = this_layer["tiles"];
-			for (auto& [id, t] : l.each<tile>())
+			mani.get_grid().for_each([&tiles](math::ivec2 pPosition, const tile_cell& pCell)
+			{
 				tiles.push_back({
-					{ "position", t.position },
-					{ "uv" , t.uv }
+					{ "position", pPosition },
+					{ "uv" , pCell.get_uv() }
 					});
+			});
 		}
 		else
 		{
@@ -59,7 +64,9 @@ static void deserialize_scene(const json& pJson, scene& pScene, const core::asse
 	for (auto& l : pJson["layers"])
 	{
 		auto& dlayer = pScene.add_layer(l["name"].get<std::string>());
-		if (l["type"] == "tileset")
+		if (util::json_get_or<bool>(l, "isolated_physics", false))
+			dlayer.layer_components.insert(physics::isolated_physics{});
+		if (l["type"] == "tilemap")
 		{
 			tilemap_manipulator mani(dlayer);
 
@@ -67,8 +74,11 @@ static void deserialize_scene(const json& pJson, scene& pScene, const core::asse
 			if (auto tileset = pAsset_mgr.get_asset(l["tileset"].get<asset_id>()))
 				mani.set_tileset(tileset);
 
+			if (util::json_get_or<bool>(l, "collision", false))
+				dlayer.layer_components.insert(physics::tilemap_collider{});
+
 			// Set the tiles.
-			for (auto& i : pJson["tiles"])
+			for (auto& i : l["tiles"])
 			{
 				tile t;
 				t.position = i["position"].get<math::ivec2>();
@@ -7,6 +7,7 @@
 #include <wge/physics/box_collider_component.hpp>
 #include <wge/physics/physics_component.hpp>
 #include <wge/physics/physics_world.hpp>
+#include <wge/physics/tilemap_collider.hpp>
 #include <wge/graphics/sprite_component.hpp>
 #include <wge/core/asset_manager.hpp>
 #include <wge/graphics/framebuffer.hpp>
@@ -51,6 +52,9 @@
 #include <future>
 #include <unordered_map>
 #include <array>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 
 namespace wge::physics
 {
@@ -613,56 +617,100 @@ public:
 class layer_previews
 {
 public:
-	// Set the interval in which to rerender previews.
-	// Default: 60 frames
-	void set_render_interval(std::size_t pFrames)
+	// Set how long re-rendering previews may take each frame. At least one
+	// out of date preview is rendered per frame so this can't stall them.
+	// Default: 2 milliseconds
+	void set_time_budget(std::chrono::microseconds pBudget)
 	{
-		assert(pFrames > 0);
-		mRender_interval = pFrames;
+		mTime_budget = pBudget;
 	}
 
+	// Only layers that changed since their preview was made are rendered again.
 	void render_previews(core::scene& pScene, graphics::renderer& pRenderer, const math::ivec2& pSize)
 	{
 		assert(pRenderer.get_graphics());
 
-		mFramebuffers.resize(pScene.get_layer_container().size());
-		++mFrame_clock;
-		if (mFrame_clock >= mRender_interval)
+		mLayers.clear();
+		for (auto& i : pScene)
+			mLayers.push_back(&i);
+
+		// Forget the layers that were removed.
+		for (auto i = mPreviews.begin(); i != mPreviews.end();)
 		{
-			graphics::framebuffer::ptr last_fb = pRenderer.get_framebuffer();
-			mFrame_clock = 0;
-			std::size_t framebuffer_idx = 0;
-			for (auto& i : pScene)
+			if (std::find(mLayers.begin(), mLayers.end(), i->first) == mLayers.end())
+				i = mPreviews.erase(i);
+			else
+				++i;
+		}
+
+		if (mLayers.empty())
+			return;
+
+		// If we are using the same renderer from the viewport,
+		// this should use the same render view.
+		const math::aabb view = pRenderer.get_render_view();
+		const auto start_time = std::chrono::steady_clock::now();
+		graphics::framebuffer::ptr last_fb = pRenderer.get_framebuffer();
+		bool rendered_any = false;
+
+		// Continue where the last frame left off so every layer gets a turn.
+		const std::size_t first = mNext_layer % mLayers.size();
+		for (std::size_t n = 0; n < mLayers.size(); n++)
+		{
+			const std::size_t layer_index = (first + n) % mLayers.size();
+			core::layer& layer = *mLayers[layer_index];
+			preview& p = mPreviews[&layer];
+
+			const bool out_of_date = !p.framebuffer
+				|| p.version != layer.get_version()
+				|| p.view.min != view.min
+				|| p.view.max != view.max
+				|| p.framebuffer->get_size() != pSize;
+			if (!out_of_date)
+				continue;
+
+			if (rendered_any && std::chrono::steady_clock::now() - start_time >= mTime_budget)
 			{
-				auto& framebuffer = mFramebuffers[framebuffer_idx];
-				if (framebuffer == nullptr)
-					framebuffer = pRenderer.get_graphics()->get_graphics_backend()->create_framebuffer();
-				if (framebuffer->get_size() != pSize)
-					framebuffer->resize(pSize.x, pSize.y);
-
-				framebuffer->clear();
-
-				pRenderer.set_framebuffer(framebuffer);
-				// If we are using the same renderer from the viewport,
-				// this should use the same render view.
-				pRenderer.render_layer(i);
-				++framebuffer_idx;
+				mNext_layer = layer_index;
+				break;
 			}
-			pRenderer.set_framebuffer(last_fb);
+
+			if (p.framebuffer == nullptr)
+				p.framebuffer = pRenderer.get_graphics()->get_graphics_backend()->create_framebuffer();
+			if (p.framebuffer->get_size() != pSize)
+				p.framebuffer->resize(pSize.x, pSize.y);
+
+			p.framebuffer->clear();
+			pRenderer.set_framebuffer(p.framebuffer);
+			pRenderer.render_layer(layer);
+			p.version = layer.get_version();
+			p.view = view;
+			rendered_any = true;
 		}
+		pRenderer.set_framebuffer(last_fb);
 	}
 
-	graphics::framebuffer::ptr get_preview_framebuffer(std::size_t pLayer_index) const
+	graphics::framebuffer::ptr get_preview_framebuffer(const core::layer& pLayer) const
 	{
-		if (pLayer_index >= mFramebuffers.size())
+		auto iter = mPreviews.find(&pLayer);
+		if (iter == mPreviews.end())
 			return nullptr;
-		return mFramebuffers[pLayer_index];
+		return iter->second.framebuffer;
 	}
 
 private:
-	std::size_t mRender_interval = 60;
-	std::size_t mFrame_clock = 0;
-	std::vector<graphics::framebuffer::ptr> mFramebuffers;
+	struct preview
+	{
+		graphics::framebuffer::ptr framebuffer;
+		// What the preview was rendered from.
+		std::uint64_t version{ 0 };
+		math::aabb view;
+	};
+
+	std::chrono::microseconds mTime_budget{ 2000 };
+	std::size_t mNext_layer = 0;
+	std::unordered_map<const core::layer*, preview> mPreviews;
+	std::vector<core::layer*> mLayers;
 };
 
 struct editor_object_info
@@ -755,12 +803,17 @@ public:
 			ImGui::TextUnformatted("Transform");
 			math::transform* transform = mSelected_object.get_component<math::transform>();
 			ImGui::BeginGroup();
-			ImGui::DragFloat2("Position", transform->position.components().data());
+			bool transform_changed = ImGui::DragFloat2("Position", transform->position.components().data());
 			math::degrees degrees = transform->rotation;
 			if (ImGui::DragFloat("Rotation", degrees.components().data()))
+			{
 				transform->rotation = degrees;
-			ImGui::DragFloat2("Scale", transform->scale.components().data());
+				transform_changed = true;
+			}
+			transform_changed |= ImGui::DragFloat2("Scale", transform->scale.components().data());
 			ImGui::EndGroup();
+			if (transform_changed)
+				mSelected_layer->mark_changed();
 			if (ImGui::IsItemDeactivatedAfterEdit())
 				mMain_editor->mark_asset_modified();
 
@@ -800,6 +853,7 @@ public:
 			if (box_edit.is_dragging())
 			{
 				is_currently_editing = true;
+				mSelected_layer->mark_changed();
 				mMain_editor->mark_asset_modified();
 			}
 
@@ -1003,7 +1057,19 @@ public:
 		{
 			tilemap.set_tileset(asset);
 			tilemap.update_tile_uvs();
+			mSelected_layer->mark_changed();
+		}
+
+		bool has_collision = mSelected_layer->layer_components.has<physics::tilemap_collider>();
+		if (ImGui::Checkbox("Collision", &has_collision))
+		{
+			if (has_collision)
+				mSelected_layer->layer_components.insert(physics::tilemap_collider{});
+			else
+				mSelected_layer->layer_components.remove<physics::tilemap_collider>();
+			mSelected_layer->mark_changed();
 		}
+		ImGui::DescriptiveToolTip("Collision", "Every tile in this layer is solid.");
 
 		auto tileset = tilemap.get_tileset();
 		if (tileset)
@@ -1051,10 +1117,18 @@ public:
 			switch (mTilemap_mode)
 			{
 			default:
-			case tilemap_mode::draw: tilemap.set_tile(tile_position, mTilemap_brush); break;
-			case tilemap_mode::erase: tilemap.clear_tile(tile_position); break;
+			case tilemap_mode::draw:
+				tilemap.set_tile(tile_position, mTilemap_brush);
+				mAabb.merge(math::aabb{ math::vec2{ tile_position },
+					math::vec2{ tile_position } + math::vec2{ 1, 1 } });
+				break;
+			case tilemap_mode::erase:
+				// Erasing can shrink the bounds so they need a full rebuild.
+				if (tilemap.clear_tile(tile_position))
+					update_aabb();
+				break;
 			}
-			update_aabb();
+			mSelected_layer->mark_changed();
 			mMain_editor->mark_asset_modified();
 		}
 	}
@@ -1068,11 +1142,12 @@ private:
 	void update_aabb()
 	{
 		mAabb.min = mAabb.max = { 0, 0 };
-		for (auto& [id, tile] : mSelected_layer->each<core::tile>())
+		core::tilemap_manipulator tilemap(*mSelected_layer);
+		tilemap.get_grid().for_each([this](math::ivec2 pPosition, const core::tile_cell&)
 		{
-			mAabb.merge(math::aabb{ math::vec2{ tile.position },
-				math::vec2{ tile.position } + math::vec2{ 1, 1 } });
-		}
+			mAabb.merge(math::aabb{ math::vec2{ pPosition },
+				math::vec2{ pPosition } + math::vec2{ 1, 1 } });
+		});
 	}
 
 private:
@@ -1184,8 +1259,7 @@ public:
 					select_layer(*i);
 				}
 				ImGui::SameLine();
-				auto preview_index = std::distance(mScene.get_layer_container().begin(), i.base()) - 1;
-				auto preview = mLayer_previews.get_preview_framebuffer(preview_index);
+				auto preview = mLayer_previews.get_preview_framebuffer(*i);
 				if (preview)
 				{
 					ImGui::Image(preview, { 30, 30 });
@@ -1578,7 +1652,10 @@ public:
 	game_viewport(core::engine& pEngine) :
 		mEngine(&pEngine),
 		mRenderer(pEngine.get_graphics())
-	{}
+	{
+		// The game is simulated while the last frame is drawn.
+		mRenderer.set_threaded_submission(true);
+	}
 
 	void open_scene(core::resource_handle<core::scene_resource> pScene)
 	{
@@ -1707,19 +1784,23 @@ public:
 
 	void step()
 	{
-
-		if (mIs_running)
-		{
-			mEngine->step();
-			mRenderer.update_animations(mEngine->get_scene(), 1.f / 60.f);
-		}
-
 		// Clear the framebuffer with black.
 		mViewport_framebuffer->clear({ 0, 0, 0, 1 });
 
-		// Render all the layers.
+		// Render all the layers. They are submitted on the renderer's
+		// thread while the next update runs.
 		mRenderer.set_view(mEngine->get_default_camera().get_view());
 		mRenderer.render_scene(mEngine->get_scene());
+
+		if (mIs_running)
+		{
+			const float elapsed = ImGui::GetIO().DeltaTime;
+			mEngine->update(elapsed);
+			mRenderer.update_animations(mEngine->get_scene(), elapsed);
+		}
+
+		// The rest of the editor draws with the same context.
+		mRenderer.wait_for_submission();
 	}
 
 	void draw_instance_error_overlays()
@@ -2059,6 +2140,9 @@ private:
 		auto& g = mEngine.get_graphics();
 		// Only glfw and opengl is supported for editing
 		g.initialize(graphics::window_backend_type::glfw, graphics::backend_type::opengl);
+		g.enable_draw_recording();
+		// Editor tools read pixels so keep a copy of every texture.
+		g.set_image_residency(graphics::image_residency::keep);
 
 		load_editor_configuration();
 
@@ -2070,6 +2154,10 @@ private:
 	{
 		while (!glfwWindowShouldClose(mGLFW_backend->get_window()))
 		{
+			auto recorder = mEngine.get_graphics().get_draw_recorder();
+			if (recorder)
+				recorder->begin_frame();
+
 			new_frame();
 
 			mContext.set_default_dock_id(ImGui::GetID("_MainDockId"));
@@ -2115,6 +2203,11 @@ private:
 			mGame_viewport.on_gui();
 			mImport_window.on_gui(mContext.get_engine().get_asset_manager(), mImport_manager);
 			show_debugger();
+			show_render_stats();
+			show_physics_stats();
+
+			if (recorder)
+				recorder->end_frame();
 
 			end_frame();
 		}
@@ -2289,6 +2382,108 @@ private:
 		ImGui::End();
 	}
 
+	void show_render_stats()
+	{
+		auto recorder = mEngine.get_graphics().get_draw_recorder();
+		if (!recorder)
+			return;
+		if (ImGui::Begin("Render Stats"))
+		{
+			const auto& stats = recorder->get_last_frame_stats();
+			const auto stat_columns = [](const char* pName, const graphics::draw_stats& pStats)
+			{
+				ImGui::TextUnformatted(pName);
+				ImGui::NextColumn();
+				ImGui::Text("%zu", pStats.batches);
+				ImGui::NextColumn();
+				ImGui::Text("%zu", pStats.vertices);
+				ImGui::NextColumn();
+				ImGui::Text("%zu", pStats.indexes);
+				ImGui::NextColumn();
+				ImGui::Text("%zu", pStats.texture_binds);
+				ImGui::NextColumn();
+				ImGui::Text("%.1f KB", static_cast<float>(pStats.bytes_uploaded) / 1024.f);
+				ImGui::NextColumn();
+			};
+
+			ImGui::Columns(6);
+			for (const char* i : { "Layer", "Batches", "Vertices", "Indexes", "Binds", "Uploaded" })
+			{
+				ImGui::TextUnformatted(i);
+				ImGui::NextColumn();
+			}
+			ImGui::Separator();
+			for (const auto& i : stats.layers)
+				stat_columns(i.name.c_str(), i.stats);
+			ImGui::Separator();
+			stat_columns("Total", stats.total);
+			ImGui::Columns(1);
+
+			if (ImGui::Button("Capture Frame"))
+				recorder->capture_next_frame();
+			if (const auto& capture = recorder->get_last_capture())
+			{
+				ImGui::SameLine();
+				if (ImGui::Button("Save Capture"))
+				{
+					std::ofstream output("./editor/frame_capture.json");
+					if (output)
+					{
+						output << capture->serialize().dump(2);
+						log::info("Saved {} batches to \"./editor/frame_capture.json\".", capture->batches.size());
+					}
+					else
+					{
+						log::error("Failed to open \"./editor/frame_capture.json\" for saving the frame capture.");
+					}
+				}
+			}
+		}
+		ImGui::End();
+	}
+
+	void show_physics_stats()
+	{
+		if (ImGui::Begin("Physics Stats"))
+		{
+			const auto show_stats = [](const char* pName, const physics::physics_stats& pStats)
+			{
+				if (!ImGui::TreeNodeEx(pName, ImGuiTreeNodeFlags_DefaultOpen))
+					return;
+				ImGui::Columns(2);
+				const auto row = [](const char* pLabel, const std::string& pValue)
+				{
+					ImGui::TextUnformatted(pLabel);
+					ImGui::NextColumn();
+					ImGui::TextUnformatted(pValue.c_str());
+					ImGui::NextColumn();
+				};
+				row("Step", fmt::format("{:.3f} ms", pStats.step));
+				row("Collide", fmt::format("{:.3f} ms", pStats.collide));
+				row("Solve", fmt::format("{:.3f} ms", pStats.solve));
+				row("Broadphase", fmt::format("{:.3f} ms", pStats.broadphase));
+				row("Solve TOI", fmt::format("{:.3f} ms", pStats.solve_toi));
+				row("Bodies", fmt::format("{} ({} inactive)", pStats.bodies, pStats.inactive_bodies));
+				row("Fixtures", fmt::format("{} ({} rebuilt)", pStats.fixtures, pStats.fixture_rebuilds));
+				row("Contacts", std::to_string(pStats.contacts));
+				row("Proxies", std::to_string(pStats.proxies));
+				row("Tree Height", std::to_string(pStats.tree_height));
+				ImGui::Columns(1);
+				ImGui::TreePop();
+			};
+
+			auto& physics = mEngine.get_physics();
+			show_stats("Main World", physics.get_stats());
+			for (auto& layer : mEngine.get_scene())
+			{
+				auto& world = physics.get_layer_world(layer);
+				if (&world != &physics)
+					show_stats(fmt::format("Layer: {}", layer.get_name()).c_str(), world.get_stats());
+			}
+		}
+		ImGui::End();
+	}
+
 	void show_debugger()
 	{
 		static std::set<std::string_view> builin_function_filter = {
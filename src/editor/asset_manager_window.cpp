@@ -190,13 +190,16 @@ void asset_manager_window::asset_tile(const core::asset::ptr& pAsset, const math
 	ImGui::BeginGroup();
 
 	const graphics::texture* preview_texture = nullptr;
+	math::aabb preview_uv{ 0.f, 0.f, 1.f, 1.f };
 
 	// Draw preview
 	if (pAsset->get_type() == "sprite")
 	{
 		auto sprite = pAsset->get_resource<graphics::sprite>();
 		assert(sprite);
+		// Atlased sprites only cover part of the page.
 		preview_texture = &sprite->get_texture();
+		preview_uv = sprite->get_uv();
 	}
 	else if (pAsset->get_type() == "tileset")
 	{
@@ -213,6 +216,7 @@ void asset_manager_window::asset_tile(const core::asset::ptr& pAsset, const math
 			auto sprite = mAsset_manager.get_resource<graphics::sprite>(object_res->display_sprite);
 			assert(sprite);
 			preview_texture = &sprite->get_texture();
+			preview_uv = sprite->get_uv();
 		}
 	}
 
@@ -228,7 +232,7 @@ void asset_manager_window::asset_tile(const core::asset::ptr& pAsset, const math
 	{
 		if (preview_texture)
 		{
-			preview_image("Preview", *preview_texture, pSize - math::vec2(ImGui::GetStyle().FramePadding) * 2);
+			preview_image("Preview", *preview_texture, pSize - math::vec2(ImGui::GetStyle().FramePadding) * 2, preview_uv);
 		}
 		else
 		{
@@ -124,6 +124,12 @@ void object_editor::display_event_list(core::object_resource* pGenerator)
 			event_menu_item(postupdate{});
 			ImGui::EndMenu();
 		}
+		if (ImGui::BeginMenu("Physics"))
+		{
+			event_menu_item(collision_begin{});
+			event_menu_item(collision_end{});
+			ImGui::EndMenu();
+		}
 		if (ImGui::BeginMenu("Rendering"))
 		{
 			event_menu_item(draw{});
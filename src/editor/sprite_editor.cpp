@@ -91,13 +91,16 @@ void sprite_editor::on_gui()
 
 		if (ImGui::CollapsingHeader("Info"))
 		{
-			ImGui::TextUnformatted(fmt::format("Frame Width: {}\nFrame Height: {}\nTexture Width: {}\nTexture Height: {}\nMemory Usage: {} bytes",
+			// Report the strip itself, not the atlas page it was packed into.
+			const math::ivec2 image_size = sprite->get_image_size();
+			ImGui::TextUnformatted(fmt::format("Frame Width: {}\nFrame Height: {}\nTexture Width: {}\nTexture Height: {}\nMemory Usage: {} bytes\nAtlased: {}",
 				sprite->get_frame_width(),
 				sprite->get_frame_height(),
-				sprite->get_texture().get_width(),
-				sprite->get_texture().get_height(),
-				sprite->get_texture().get_width() * sprite->get_texture().get_height() * 4).c_str());
-;		}
+				image_size.x,
+				image_size.y,
+				image_size.x * image_size.y * 4,
+				sprite->is_in_atlas() ? "Yes" : "No").c_str());
+		}
 	}
 	ImGui::EndChild();
 
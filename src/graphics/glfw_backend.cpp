@@ -72,6 +72,16 @@ void glfw_window_backend::refresh()
 	glfwSwapBuffers(mWindow);
 }
 
+void glfw_window_backend::make_context_current()
+{
+	glfwMakeContextCurrent(mWindow);
+}
+
+void glfw_window_backend::release_context()
+{
+	glfwMakeContextCurrent(nullptr);
+}
+
 void glfw_window_backend::serialize_settings(json& pJson)
 {
 	int width = 0, height = 0;
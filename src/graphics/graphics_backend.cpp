@@ -7,6 +7,7 @@ namespace wge::graphics
 {
 
 graphics_backend::ptr create_opengl_backend();
+graphics_backend::ptr create_software_backend();
 window_backend::ptr create_glfw_backend(backend_type pFor_backend);
 
 graphics_backend::ptr graphics_backend::create(backend_type pBackend)
@@ -17,6 +18,8 @@ graphics_backend::ptr graphics_backend::create(backend_type pBackend)
 		return std::make_shared<null_graphics_backend>();
 	case backend_type::opengl:
 		return create_opengl_backend();
+	case backend_type::software:
+		return create_software_backend();
 	default:
 		log::error("Unsupported rendering backend, defaulting with null device.");
 		return std::make_shared<null_graphics_backend>();
@@ -7,6 +7,9 @@
 
 #include <GL/glew.h>
 
+#include <cstddef>
+#include <vector>
+
 namespace wge::graphics
 {
 
@@ -41,6 +44,99 @@ inline void GLAPIENTRY opengl_message_callback(GLenum source,
 	log::print(level, "OpenGL: {}", message);
 }
 
+// Sets up the attributes of the currently bound vertex buffer for packed_vertex_2d.
+inline void setup_packed_vertex_attributes(bool pWith_uv)
+{
+	// Setup the 2d position attribute.
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(packed_vertex_2d), (void*)offsetof(packed_vertex_2d, position));
+
+	if (pWith_uv)
+	{
+		// Setup the UV attribute. These are normalized 16-bit integers.
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(packed_vertex_2d), (void*)offsetof(packed_vertex_2d, uv));
+	}
+
+	// Setup the color attribute. These are normalized 8-bit integers.
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(packed_vertex_2d), (void*)offsetof(packed_vertex_2d, color));
+}
+
+class opengl_retained_geometry :
+	public retained_geometry
+{
+public:
+	opengl_retained_geometry()
+	{
+		glGenVertexArrays(1, &mVAO_id);
+		glBindVertexArray(mVAO_id);
+
+		glGenBuffers(1, &mVertex_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, mVertex_buffer);
+		glGenBuffers(1, &mElement_buffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mElement_buffer);
+
+		// The vertex array remembers these so they only need to be setup once.
+		setup_packed_vertex_attributes(true);
+
+		glBindVertexArray(0);
+	}
+
+	virtual ~opengl_retained_geometry()
+	{
+		glDeleteBuffers(1, &mVertex_buffer);
+		glDeleteBuffers(1, &mElement_buffer);
+		glDeleteVertexArrays(1, &mVAO_id);
+	}
+
+	virtual void update(util::span<const packed_vertex_2d> pVertices, util::span<const unsigned int> pIndexes) override
+	{
+		glBindVertexArray(mVAO_id);
+		glBindBuffer(GL_ARRAY_BUFFER, mVertex_buffer);
+		glBufferData(GL_ARRAY_BUFFER, pVertices.size() * sizeof(packed_vertex_2d), pVertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mElement_buffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, pIndexes.size() * sizeof(unsigned int), pIndexes.data(), GL_STATIC_DRAW);
+		glBindVertexArray(0);
+		mVertex_count = pVertices.size();
+		mIndex_count = pIndexes.size();
+	}
+
+	virtual std::size_t get_vertex_count() const override
+	{
+		return mVertex_count;
+	}
+
+	virtual std::size_t get_index_count() const override
+	{
+		return mIndex_count;
+	}
+
+	virtual bool read_back(std::vector<packed_vertex_2d>& pVertices, std::vector<unsigned int>& pIndexes) const override
+	{
+		pVertices.resize(mVertex_count);
+		pIndexes.resize(mIndex_count);
+		glBindBuffer(GL_ARRAY_BUFFER, mVertex_buffer);
+		glGetBufferSubData(GL_ARRAY_BUFFER, 0, mVertex_count * sizeof(packed_vertex_2d), pVertices.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		// Bind through the vertex array so the element buffer binding isn't lost.
+		glBindVertexArray(mVAO_id);
+		glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, mIndex_count * sizeof(unsigned int), pIndexes.data());
+		glBindVertexArray(0);
+		return true;
+	}
+
+	GLuint get_vao() const noexcept
+	{
+		return mVAO_id;
+	}
+
+private:
+	GLuint mVertex_buffer{ 0 }, mElement_buffer{ 0 }, mVAO_id{ 0 };
+	std::size_t mVertex_count{ 0 };
+	std::size_t mIndex_count{ 0 };
+};
+
 class opengl_backend_impl :
 	public graphics_backend
 {
@@ -49,9 +145,12 @@ public:
 	{
 		glDeleteBuffers(1, &mVertex_buffer);
 		glDeleteBuffers(1, &mElement_buffer);
+		glDeleteBuffers(1, &mInstance_buffer);
 		glDeleteVertexArrays(1, &mVAO_id);
+		glDeleteVertexArrays(1, &mInstance_VAO_id);
 		glDeleteProgram(mShader_texture);
 		glDeleteProgram(mShader_color);
+		glDeleteProgram(mShader_instanced);
 	}
 
 	virtual void initialize() override
@@ -73,6 +172,10 @@ public:
 			shaders::vertex_color,
 			shaders::fragment_color
 		);
+		mShader_instanced = load_shaders(
+			shaders::vertex_sprite_instanced,
+			shaders::fragment_texture
+		);
 
 		glGenVertexArrays(1, &mVAO_id);
 		glBindVertexArray(mVAO_id);
@@ -82,12 +185,24 @@ public:
 
 		// Allocate ahead of time
 		glBindBuffer(GL_ARRAY_BUFFER, mVertex_buffer);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_2d) * 4, NULL, GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(packed_vertex_2d) * 4, NULL, GL_STATIC_DRAW);
 
 		// Create the element buffer to hold our indexes
 		glGenBuffers(1, &mElement_buffer);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mElement_buffer);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6, NULL, GL_STATIC_DRAW);
+
+		glBindVertexArray(0);
+
+		initialize_instancing();
+
+		mUploads = std::make_shared<opengl_upload_queue>();
+		mUploads->initialize();
+	}
+
+	virtual bool supports_instancing() const override
+	{
+		return true;
 	}
 
 	virtual void render_batch(const framebuffer::ptr& mFramebuffer, const math::mat44& pProjection, const render_batch_2d& pBatch) override
@@ -98,8 +213,20 @@ public:
 		if (!ogl_framebuffer)
 			return;
 
+		if (pBatch.retained)
+		{
+			render_retained(*ogl_framebuffer, pProjection, pBatch);
+			return;
+		}
+
+		if (!pBatch.instances.empty())
+		{
+			render_instances(*ogl_framebuffer, pProjection, pBatch);
+			return;
+		}
+
 		const util::span<const unsigned int> indexes = pBatch.use_indirect_source ? pBatch.indexes_indirect : pBatch.indexes;
-		const util::span<const vertex_2d> vertices = pBatch.use_indirect_source ? pBatch.vertices_indirect : pBatch.vertices;
+		const util::span<const packed_vertex_2d> vertices = pBatch.use_indirect_source ? pBatch.vertices_indirect : pack_vertices(pBatch.vertices);
 
 		ogl_framebuffer->begin_framebuffer();
 
@@ -109,7 +236,7 @@ public:
 
 		// Populate the vertex buffer.
 		glBindBuffer(GL_ARRAY_BUFFER, mVertex_buffer);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertex_2d), &vertices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(packed_vertex_2d), &vertices[0], GL_STATIC_DRAW);
 
 		// Populate the element buffer with index data.
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mElement_buffer);
@@ -132,23 +259,8 @@ public:
 			glUniform1i(tex_id, 0);
 		}
 
-		// Setup the 2d position attribute.
-		glEnableVertexAttribArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, mVertex_buffer);
-		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(vertex_2d), (void*)0);
-
-		if (pBatch.rendertexture)
-		{
-			// Setup the UV attribute.
-			glEnableVertexAttribArray(1);
-			glBindBuffer(GL_ARRAY_BUFFER, mVertex_buffer);
-			glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertex_2d), (void*)sizeof(math::vec2));
-		}
-
-		// Setup the color attribute.
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, mVertex_buffer);
-		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(vertex_2d), (void*)(sizeof(math::vec2) * 2));
+		setup_packed_vertex_attributes(pBatch.rendertexture != nullptr);
 
 		// Bind the element buffer.
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mElement_buffer);
@@ -180,13 +292,155 @@ public:
 	}
 
 	virtual texture_impl::ptr create_texture_impl() override
+	{
+		// Textures created before initialize can't be queued.
+		if (!mUploads)
+			return std::make_shared<opengl_texture_impl>();
+		return std::make_shared<opengl_texture_impl>(mUploads);
+	}
+
+	virtual texture_impl::ptr create_immediate_texture_impl() override
 	{
 		return std::make_shared<opengl_texture_impl>();
 	}
 
+	virtual void process_uploads() override
+	{
+		if (mUploads)
+			mUploads->process();
+	}
+
+	virtual void set_upload_budget(std::size_t pBytes) override
+	{
+		if (mUploads)
+			mUploads->set_budget(pBytes);
+	}
+
+	virtual retained_geometry::ptr create_retained_geometry() override
+	{
+		return std::make_shared<opengl_retained_geometry>();
+	}
+
+private:
+	void initialize_instancing()
+	{
+		glGenVertexArrays(1, &mInstance_VAO_id);
+		glBindVertexArray(mInstance_VAO_id);
+
+		glGenBuffers(1, &mInstance_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, mInstance_buffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(sprite_instance_2d), NULL, GL_STREAM_DRAW);
+
+		// The attributes only need to be setup once since the vertex array remembers them.
+		const auto setup_attribute = [](GLuint pLocation, GLint pSize, GLenum pType, GLboolean pNormalized, std::size_t pOffset)
+		{
+			glEnableVertexAttribArray(pLocation);
+			glVertexAttribPointer(pLocation, pSize, pType, pNormalized, sizeof(sprite_instance_2d), (void*)pOffset);
+			// Advance once per instance instead of per vertex.
+			glVertexAttribDivisor(pLocation, 1);
+		};
+		setup_attribute(3, 2, GL_FLOAT, GL_FALSE, offsetof(sprite_instance_2d, position));
+		setup_attribute(4, 2, GL_FLOAT, GL_FALSE, offsetof(sprite_instance_2d, scale));
+		setup_attribute(5, 2, GL_FLOAT, GL_FALSE, offsetof(sprite_instance_2d, size));
+		setup_attribute(6, 2, GL_FLOAT, GL_FALSE, offsetof(sprite_instance_2d, anchor));
+		setup_attribute(7, 4, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(sprite_instance_2d, uv_rect));
+		setup_attribute(8, 1, GL_FLOAT, GL_FALSE, offsetof(sprite_instance_2d, rotation));
+		setup_attribute(9, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(sprite_instance_2d, color));
+
+		glBindVertexArray(0);
+	}
+
+	void render_instances(const opengl_framebuffer& pFramebuffer, const math::mat44& pProjection, const render_batch_2d& pBatch)
+	{
+		pFramebuffer.begin_framebuffer();
+
+		glViewport(0, 0, pFramebuffer.get_width(), pFramebuffer.get_height());
+
+		glBindVertexArray(mInstance_VAO_id);
+
+		// Populate the instance buffer.
+		glBindBuffer(GL_ARRAY_BUFFER, mInstance_buffer);
+		glBufferData(GL_ARRAY_BUFFER, pBatch.instances.size() * sizeof(sprite_instance_2d), pBatch.instances.data(), GL_STREAM_DRAW);
+
+		glUseProgram(mShader_instanced);
+
+		GLuint proj_id = glGetUniformLocation(mShader_instanced, "projection");
+		glUniformMatrix4fv(proj_id, 1, GL_FALSE, &pProjection.m[0][0]);
+
+		if (pBatch.rendertexture && pBatch.rendertexture->get_implementation())
+		{
+			glActiveTexture(GL_TEXTURE0);
+			auto impl = std::dynamic_pointer_cast<opengl_texture_impl>(pBatch.rendertexture->get_implementation());
+			glBindTexture(GL_TEXTURE_2D, impl->get_gl_texture());
+			GLuint tex_id = glGetUniformLocation(mShader_instanced, "tex");
+			glUniform1i(tex_id, 0);
+		}
+
+		// 4 vertices for each quad. The shader does the rest.
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(pBatch.instances.size()));
+
+		glUseProgram(0);
+
+		glBindVertexArray(0);
+
+		pFramebuffer.end_framebuffer();
+	}
+
+	void render_retained(const opengl_framebuffer& pFramebuffer, const math::mat44& pProjection, const render_batch_2d& pBatch)
+	{
+		auto geometry = dynamic_cast<const opengl_retained_geometry*>(pBatch.retained);
+		if (!geometry)
+			return;
+
+		pFramebuffer.begin_framebuffer();
+
+		glViewport(0, 0, pFramebuffer.get_width(), pFramebuffer.get_height());
+
+		// Everything is already uploaded so just bind and draw.
+		glBindVertexArray(geometry->get_vao());
+
+		GLuint current_shader = pBatch.rendertexture ? mShader_texture : mShader_color;
+		glUseProgram(current_shader);
+
+		GLuint proj_id = glGetUniformLocation(current_shader, "projection");
+		glUniformMatrix4fv(proj_id, 1, GL_FALSE, &pProjection.m[0][0]);
+
+		if (pBatch.rendertexture && pBatch.rendertexture->get_implementation())
+		{
+			glActiveTexture(GL_TEXTURE0);
+			auto impl = std::dynamic_pointer_cast<opengl_texture_impl>(pBatch.rendertexture->get_implementation());
+			glBindTexture(GL_TEXTURE_2D, impl->get_gl_texture());
+			GLuint tex_id = glGetUniformLocation(current_shader, "tex");
+			glUniform1i(tex_id, 0);
+		}
+
+		glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(geometry->get_index_count()), GL_UNSIGNED_INT, (void*)0);
+
+		glUseProgram(0);
+
+		glBindVertexArray(0);
+
+		pFramebuffer.end_framebuffer();
+	}
+
+	// Convert the vertices into the format the shaders expect.
+	// The returned span is only valid until the next call.
+	util::span<const packed_vertex_2d> pack_vertices(util::span<const vertex_2d> pVertices)
+	{
+		mPacked_vertices.clear();
+		mPacked_vertices.reserve(pVertices.size());
+		for (const auto& i : pVertices)
+			mPacked_vertices.emplace_back(i);
+		return mPacked_vertices;
+	}
+
 private:
+	// Staging buffer for batches that aren't already packed.
+	std::vector<packed_vertex_2d> mPacked_vertices;
 	GLuint mVertex_buffer{ 0 }, mElement_buffer{ 0 }, mVAO_id{ 0 };
-	GLuint mShader_texture{ 0 }, mShader_color{ 0 };
+	GLuint mInstance_buffer{ 0 }, mInstance_VAO_id{ 0 };
+	GLuint mShader_texture{ 0 }, mShader_color{ 0 }, mShader_instanced{ 0 };
+	std::shared_ptr<opengl_upload_queue> mUploads;
 };
 
 graphics_backend::ptr create_opengl_backend()
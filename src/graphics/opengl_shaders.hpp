@@ -78,6 +78,8 @@ constexpr const char* fragment_texture = "#version 330 core\n" R"(
 	}
 )";
 
+// The vertex attributes are sourced from packed_vertex_2d. The uv and color
+// attributes are normalized integers so OpenGL converts them to floats for us.
 constexpr const char* vertex_color = "#version 330 core\n" STRINGIFY(
 	layout(location = 0) in vec2 vertex_position;
 	layout(location = 2) in vec4 vertex_color;
@@ -111,6 +113,36 @@ constexpr const char* vertex_texture = "#version 330 core\n" STRINGIFY(
 	}
 );
 
+// Instanced sprite shader. Each instance is a sprite_instance_2d and
+// the quad is expanded from gl_VertexID so no vertex buffer is needed.
+// Draw with GL_TRIANGLE_STRIP and 4 vertices per instance.
+constexpr const char* vertex_sprite_instanced = "#version 330 core\n" STRINGIFY(
+	layout(location = 3) in vec2 instance_position;
+	layout(location = 4) in vec2 instance_scale;
+	layout(location = 5) in vec2 instance_size;
+	layout(location = 6) in vec2 instance_anchor;
+	layout(location = 7) in vec4 instance_uv_rect;
+	layout(location = 8) in float instance_rotation;
+	layout(location = 9) in vec4 instance_color;
+
+	uniform mat4 projection;
+
+	out vec2 uv;
+	out vec4 color;
+
+	void main()
+	{
+		vec2 corner = vec2(float(gl_VertexID % 2), float(gl_VertexID / 2));
+		vec2 local = (corner * instance_size - instance_anchor) * instance_scale;
+		float s = sin(instance_rotation);
+		float c = cos(instance_rotation);
+		vec2 world = instance_position + vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+		uv = mix(instance_uv_rect.xy, instance_uv_rect.zw, corner);
+		color = instance_color;
+		gl_Position = projection * vec4(world, 0, 1.0);
+	}
+);
+
 } // namespace wge::graphics::shaders
 
 #undef STRINGIFY
@@ -0,0 +1,391 @@
+#include <wge/graphics/recording_backend.hpp>
+#include <wge/logging/log.hpp>
+
+#include <algorithm>
+#include <iterator>
+
+namespace wge::graphics
+{
+
+// Forwards to the wrapped backend's geometry and counts the bytes uploaded.
+// Nothing is copied. Captures read the wrapped geometry back instead.
+class recording_retained_geometry :
+	public retained_geometry
+{
+public:
+	recording_retained_geometry(const retained_geometry::ptr& pGeometry, const std::shared_ptr<std::size_t>& pBytes_counter) :
+		mGeometry(pGeometry),
+		mBytes_counter(pBytes_counter)
+	{}
+
+	virtual void update(util::span<const packed_vertex_2d> pVertices, util::span<const unsigned int> pIndexes) override
+	{
+		mGeometry->update(pVertices, pIndexes);
+		*mBytes_counter += pVertices.size() * sizeof(packed_vertex_2d) + pIndexes.size() * sizeof(unsigned int);
+	}
+
+	virtual std::size_t get_vertex_count() const override
+	{
+		return mGeometry->get_vertex_count();
+	}
+
+	virtual std::size_t get_index_count() const override
+	{
+		return mGeometry->get_index_count();
+	}
+
+	const retained_geometry* get_wrapped_geometry() const noexcept
+	{
+		return mGeometry.get();
+	}
+
+private:
+	retained_geometry::ptr mGeometry;
+	std::shared_ptr<std::size_t> mBytes_counter;
+};
+
+json draw_stats::serialize() const
+{
+	json result;
+	result["batches"] = batches;
+	result["vertices"] = vertices;
+	result["indexes"] = indexes;
+	result["instances"] = instances;
+	result["texture_binds"] = texture_binds;
+	result["bytes_uploaded"] = bytes_uploaded;
+	return result;
+}
+
+json frame_draw_stats::serialize() const
+{
+	json result;
+	result["frame"] = frame_number;
+	result["total"] = total.serialize();
+	json& layers_json = result["layers"] = json::array();
+	for (const auto& i : layers)
+	{
+		json layer_json = i.stats.serialize();
+		layer_json["name"] = i.name;
+		layers_json.push_back(std::move(layer_json));
+	}
+	return result;
+}
+
+json captured_frame::serialize() const
+{
+	json result;
+	json& textures_json = result["textures"] = json::array();
+	for (const auto& i : texture_sizes)
+		textures_json.push_back({ i.x, i.y });
+
+	json& batches_json = result["batches"] = json::array();
+	for (const auto& i : batches)
+	{
+		json batch_json;
+		batch_json["layer"] = i.layer;
+		batch_json["type"] = static_cast<int>(i.type);
+		batch_json["depth"] = i.depth;
+		batch_json["texture"] = i.texture;
+
+		json& projection_json = batch_json["projection"] = json::array();
+		for (const auto& column : i.projection.m)
+			for (float value : column)
+				projection_json.push_back(value);
+
+		// Each vertex is [x, y, u, v, r, g, b, a].
+		json& vertices_json = batch_json["vertices"] = json::array();
+		for (const auto& v : i.vertices)
+			vertices_json.push_back({ v.position.x, v.position.y, v.uv.x, v.uv.y, v.color.r, v.color.g, v.color.b, v.color.a });
+
+		batch_json["indexes"] = i.indexes;
+
+		// Each instance is [position x, y, scale x, y, size x, y, anchor x, y,
+		// uv min x, y, uv max x, y, rotation, r, g, b, a].
+		json& instances_json = batch_json["instances"] = json::array();
+		for (const auto& n : i.instances)
+		{
+			instances_json.push_back({
+				n.position.x, n.position.y, n.scale.x, n.scale.y,
+				n.size.x, n.size.y, n.anchor.x, n.anchor.y,
+				n.uv_rect[0], n.uv_rect[1], n.uv_rect[2], n.uv_rect[3],
+				n.rotation, n.color.r, n.color.g, n.color.b, n.color.a });
+		}
+
+		batches_json.push_back(std::move(batch_json));
+	}
+	return result;
+}
+
+void captured_frame::deserialize(const json& pJson)
+{
+	texture_sizes.clear();
+	for (const auto& i : pJson["textures"])
+		texture_sizes.push_back({ i[0].get<int>(), i[1].get<int>() });
+
+	batches.clear();
+	for (const auto& batch_json : pJson["batches"])
+	{
+		captured_batch& batch = batches.emplace_back();
+		batch.layer = batch_json["layer"].get<std::string>();
+		batch.type = static_cast<primitive_type>(batch_json["type"].get<int>());
+		batch.depth = batch_json["depth"];
+		batch.texture = batch_json["texture"];
+
+		const json& projection_json = batch_json["projection"];
+		for (std::size_t column = 0; column < 4; column++)
+			for (std::size_t row = 0; row < 4; row++)
+				batch.projection.m[column][row] = projection_json[column * 4 + row];
+
+		for (const auto& v : batch_json["vertices"])
+		{
+			vertex_2d& vertex = batch.vertices.emplace_back();
+			vertex.position = { v[0].get<float>(), v[1].get<float>() };
+			vertex.uv = { v[2].get<float>(), v[3].get<float>() };
+			vertex.color = { v[4].get<float>(), v[5].get<float>(), v[6].get<float>(), v[7].get<float>() };
+		}
+
+		batch.indexes = batch_json["indexes"].get<std::vector<unsigned int>>();
+
+		for (const auto& n : batch_json["instances"])
+		{
+			sprite_instance_2d& instance = batch.instances.emplace_back();
+			instance.position = { n[0].get<float>(), n[1].get<float>() };
+			instance.scale = { n[2].get<float>(), n[3].get<float>() };
+			instance.size = { n[4].get<float>(), n[5].get<float>() };
+			instance.anchor = { n[6].get<float>(), n[7].get<float>() };
+			for (std::size_t uv = 0; uv < 4; uv++)
+				instance.uv_rect[uv] = n[8 + uv].get<std::uint16_t>();
+			instance.rotation = n[12];
+			instance.color = { n[13].get<std::uint8_t>(), n[14].get<std::uint8_t>(),
+				n[15].get<std::uint8_t>(), n[16].get<std::uint8_t>() };
+		}
+	}
+}
+
+void captured_frame::replay(graphics_backend& pBackend, const framebuffer::ptr& pFramebuffer,
+	const std::vector<const texture*>& pTextures) const
+{
+	for (const auto& i : batches)
+	{
+		render_batch_2d batch;
+		batch.type = i.type;
+		batch.depth = i.depth;
+		if (i.texture >= 0 && static_cast<std::size_t>(i.texture) < pTextures.size())
+			batch.rendertexture = pTextures[i.texture];
+		batch.vertices = i.vertices;
+		batch.indexes = i.indexes;
+		if (!i.instances.empty())
+		{
+			// Backends without instancing get nothing so skip them.
+			if (!pBackend.supports_instancing())
+				continue;
+			batch.instances = util::span<const sprite_instance_2d>{ i.instances.data(), i.instances.size() };
+		}
+		pBackend.render_batch(pFramebuffer, i.projection, batch);
+	}
+}
+
+recording_backend::recording_backend(const graphics_backend::ptr& pBackend) :
+	mBackend(pBackend)
+{}
+
+void recording_backend::initialize()
+{
+	mBackend->initialize();
+}
+
+void recording_backend::render_batch(const framebuffer::ptr& mFramebuffer, const math::mat44& pProjection, const render_batch_2d& pBatch)
+{
+	if (pBatch.empty())
+		return;
+
+	draw_stats& stats = get_current_layer_stats();
+	++stats.batches;
+	stats.bytes_uploaded += *mRetained_bytes;
+	*mRetained_bytes = 0;
+	if (pBatch.rendertexture && pBatch.rendertexture != mLast_texture)
+		++stats.texture_binds;
+	mLast_texture = pBatch.rendertexture;
+
+	if (pBatch.retained)
+	{
+		stats.vertices += pBatch.retained->get_vertex_count();
+		stats.indexes += pBatch.retained->get_index_count();
+	}
+	else if (!pBatch.instances.empty())
+	{
+		stats.instances += pBatch.instances.size();
+		stats.vertices += pBatch.instances.size() * 4;
+		stats.bytes_uploaded += pBatch.instances.size() * sizeof(sprite_instance_2d);
+	}
+	else
+	{
+		const std::size_t vertex_count = pBatch.use_indirect_source ? pBatch.vertices_indirect.size() : pBatch.vertices.size();
+		const std::size_t index_count = pBatch.use_indirect_source ? pBatch.indexes_indirect.size() : pBatch.indexes.size();
+		stats.vertices += vertex_count;
+		stats.indexes += index_count;
+		// Everything is packed before it is uploaded.
+		stats.bytes_uploaded += vertex_count * sizeof(packed_vertex_2d) + index_count * sizeof(unsigned int);
+	}
+
+	if (mCapture)
+		capture_batch(pProjection, pBatch);
+
+	// The wrapped backend only knows its own geometry.
+	if (auto geometry = dynamic_cast<const recording_retained_geometry*>(pBatch.retained))
+	{
+		render_batch_2d unwrapped = pBatch;
+		unwrapped.retained = geometry->get_wrapped_geometry();
+		mBackend->render_batch(mFramebuffer, pProjection, unwrapped);
+	}
+	else
+	{
+		mBackend->render_batch(mFramebuffer, pProjection, pBatch);
+	}
+}
+
+framebuffer::ptr recording_backend::create_framebuffer()
+{
+	return mBackend->create_framebuffer();
+}
+
+texture_impl::ptr recording_backend::create_texture_impl()
+{
+	return mBackend->create_texture_impl();
+}
+
+texture_impl::ptr recording_backend::create_immediate_texture_impl()
+{
+	return mBackend->create_immediate_texture_impl();
+}
+
+bool recording_backend::supports_instancing() const
+{
+	return mBackend->supports_instancing();
+}
+
+retained_geometry::ptr recording_backend::create_retained_geometry()
+{
+	auto geometry = mBackend->create_retained_geometry();
+	if (!geometry)
+		return{};
+	return std::make_shared<recording_retained_geometry>(geometry, mRetained_bytes);
+}
+
+void recording_backend::begin_layer(std::string_view pName)
+{
+	// Layers that are drawn more than once in a frame are merged.
+	auto iter = std::find_if(mCurrent_frame.layers.begin(), mCurrent_frame.layers.end(),
+		[&](const layer_draw_stats& pLayer) { return pLayer.name == pName; });
+	if (iter == mCurrent_frame.layers.end())
+	{
+		mCurrent_frame.layers.push_back({ std::string(pName), {} });
+		iter = std::prev(mCurrent_frame.layers.end());
+	}
+	mCurrent_layer = static_cast<std::size_t>(iter - mCurrent_frame.layers.begin());
+	mBackend->begin_layer(pName);
+}
+
+void recording_backend::process_uploads()
+{
+	mBackend->process_uploads();
+}
+
+void recording_backend::set_upload_budget(std::size_t pBytes)
+{
+	mBackend->set_upload_budget(pBytes);
+}
+
+void recording_backend::begin_frame()
+{
+	mCurrent_frame.total = {};
+	mCurrent_frame.layers.clear();
+	mCurrent_layer = 0;
+	mLast_texture = nullptr;
+	if (mCapture_requested)
+	{
+		mCapture_requested = false;
+		mCapture.emplace();
+		mCapture_textures.clear();
+	}
+}
+
+void recording_backend::end_frame()
+{
+	for (const auto& i : mCurrent_frame.layers)
+		mCurrent_frame.total += i.stats;
+	mLast_frame = mCurrent_frame;
+	++mCurrent_frame.frame_number;
+
+	if (mCapture)
+	{
+		mLast_capture = std::move(mCapture);
+		mCapture.reset();
+	}
+
+	if (mStats_log.is_open())
+		mStats_log << mLast_frame.serialize().dump() << '\n';
+}
+
+void recording_backend::set_stats_log(const std::string& pPath)
+{
+	mStats_log.close();
+	if (pPath.empty())
+		return;
+	mStats_log.open(pPath, std::ios::app);
+	if (!mStats_log)
+		log::error("Could not open \"{}\" for logging render stats.", pPath);
+}
+
+draw_stats& recording_backend::get_current_layer_stats()
+{
+	// Anything drawn outside of a layer still needs to go somewhere.
+	if (mCurrent_frame.layers.empty())
+		mCurrent_frame.layers.push_back({ "<no layer>", {} });
+	return mCurrent_frame.layers[mCurrent_layer].stats;
+}
+
+void recording_backend::capture_batch(const math::mat44& pProjection, const render_batch_2d& pBatch)
+{
+	captured_batch& batch = mCapture->batches.emplace_back();
+	batch.layer = mCurrent_frame.layers[mCurrent_layer].name;
+	batch.type = pBatch.type;
+	batch.depth = pBatch.depth;
+	batch.projection = pProjection;
+
+	if (pBatch.rendertexture)
+	{
+		auto [iter, inserted] = mCapture_textures.try_emplace(pBatch.rendertexture, static_cast<int>(mCapture->texture_sizes.size()));
+		if (inserted)
+			mCapture->texture_sizes.push_back(pBatch.rendertexture->get_size());
+		batch.texture = iter->second;
+	}
+
+	if (auto geometry = dynamic_cast<const recording_retained_geometry*>(pBatch.retained))
+	{
+		// Only read back while capturing so no copies live between frames.
+		std::vector<packed_vertex_2d> vertices;
+		if (!geometry->get_wrapped_geometry()->read_back(vertices, batch.indexes))
+			log::warning("Retained geometry of layer \"{}\" could not be captured.", batch.layer);
+		for (const auto& i : vertices)
+			batch.vertices.push_back(i.unpack());
+		batch.type = primitive_type::triangles;
+	}
+	else if (!pBatch.instances.empty())
+	{
+		batch.instances.assign(pBatch.instances.begin(), pBatch.instances.end());
+	}
+	else if (pBatch.use_indirect_source)
+	{
+		for (const auto& i : pBatch.vertices_indirect)
+			batch.vertices.push_back(i.unpack());
+		batch.indexes.assign(pBatch.indexes_indirect.begin(), pBatch.indexes_indirect.end());
+	}
+	else
+	{
+		batch.vertices = pBatch.vertices;
+		batch.indexes = pBatch.indexes;
+	}
+}
+
+} // namespace wge::graphics
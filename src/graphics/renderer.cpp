@@ -3,6 +3,11 @@
 #include <cassert>
 #include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 #include <wge/graphics/renderer.hpp>
 #include <wge/graphics/framebuffer.hpp>
@@ -14,30 +19,105 @@
 namespace wge::graphics
 {
 
-std::size_t batch_builder::add_quad(util::span<vertex_2d> pBuffer)
+// Replays the command lists of a frame on its own thread so the caller
+// can get on with the next frame. The graphics context is handed over
+// for each frame and taken back by wait().
+class renderer::submission_thread
 {
-	assert(pBuffer.size() == 4);
-	std::size_t start_index = mBatch.vertices.size();
+public:
+	submission_thread() :
+		mThread([this]() { run(); })
+	{}
 
-	// Make sure there is enough space
-	mBatch.indexes.reserve(mBatch.indexes.size() + 6);
+	~submission_thread()
+	{
+		{
+			std::lock_guard lock{ mMutex };
+			mStop = true;
+		}
+		mCondition.notify_all();
+		mThread.join();
+	}
 
-	// Triangle 1 indexes
-	mBatch.indexes.push_back(start_index);
-	mBatch.indexes.push_back(start_index + 1);
-	mBatch.indexes.push_back(start_index + 2);
+	void start(renderer& pRenderer, std::size_t pCount)
+	{
+		mWindow = pRenderer.mGraphics->get_window_backend();
+		// Only one thread can have the context at a time.
+		if (mWindow)
+			mWindow->release_context();
+		{
+			std::lock_guard lock{ mMutex };
+			mRenderer = &pRenderer;
+			mCount = pCount;
+			mPending = true;
+		}
+		mCondition.notify_all();
+		mIn_flight = true;
+	}
 
-	// Triangle 2 indexes
-	mBatch.indexes.push_back(start_index + 2);
-	mBatch.indexes.push_back(start_index + 3);
-	mBatch.indexes.push_back(start_index);
+	void wait()
+	{
+		if (!mIn_flight)
+			return;
+		{
+			std::unique_lock lock{ mMutex };
+			mCondition.wait(lock, [this]() { return !mPending; });
+		}
+		mIn_flight = false;
+		if (mWindow)
+			mWindow->make_context_current();
+	}
 
-	// Add the vertices.
-	mBatch.vertices.reserve(mBatch.vertices.size() + 4);
-	for (std::size_t i = 0; i < 4; i++)
-		mBatch.vertices.push_back(pBuffer[i]);
+private:
+	void run()
+	{
+		std::unique_lock lock{ mMutex };
+		for (;;)
+		{
+			mCondition.wait(lock, [this]() { return mStop || mPending; });
+			if (mStop)
+				return;
 
-	return start_index;
+			lock.unlock();
+			if (mWindow)
+				mWindow->make_context_current();
+			for (std::size_t i = 0; i < mCount; i++)
+				mRenderer->submit(mRenderer->mCommand_lists[i]);
+			if (mWindow)
+				mWindow->release_context();
+			lock.lock();
+
+			mPending = false;
+			mCondition.notify_all();
+		}
+	}
+
+private:
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	renderer* mRenderer = nullptr;
+	window_backend::ptr mWindow;
+	std::size_t mCount{ 0 };
+	bool mPending{ false };
+	bool mStop{ false };
+	// Only used by the thread that starts and waits.
+	bool mIn_flight{ false };
+	// Last so everything above is ready before it starts.
+	std::thread mThread;
+};
+
+renderer::renderer() = default;
+
+renderer::renderer(graphics& pGraphics) :
+	mGraphics(&pGraphics)
+{}
+
+renderer::renderer(renderer&&) noexcept = default;
+renderer& renderer::operator=(renderer&&) noexcept = default;
+
+renderer::~renderer()
+{
+	wait_for_submission();
 }
 
 void renderer::set_view(const math::aabb& pView) noexcept
@@ -92,62 +172,332 @@ math::vec2 renderer::screen_to_world(const math::vec2& pVec) const noexcept
 	return (pVec * get_render_view_scale()) + mRender_view.min;
 }
 
-void renderer::render_sprites(core::layer& pLayer)
+void render_command_list::clear()
+{
+	mBatches.clear();
+	mTilemap_chunks.clear();
+	mTileset_texture = nullptr;
+	mFramebuffer.reset();
+}
+
+void renderer::build_layer(core::layer& pLayer, render_command_list& pList)
 {
+	pList.clear();
+	reset_layer_stats(pLayer, pList.mStats);
+	pList.mProjection_matrix = math::ortho(mRender_view);
+	pList.mFramebuffer = mFramebuffer;
+	build_sprites(pLayer, pList);
+	build_tilemap(pLayer, pList);
+}
+
+void renderer::build_sprites(core::layer& pLayer, render_command_list& pList)
+{
+	const bool use_instancing = mGraphics->get_graphics_backend()->supports_instancing();
+	const float pixel_scale = get_pixel_scale();
+	layer_render_stats& stats = pList.mStats;
+
+	// Every sprite gets at most one instance so this is enough for the whole layer.
+	// Consecutive instances that share a texture are drawn as one batch.
+	util::span<sprite_instance_2d> instances;
+	if (use_instancing)
+		instances = pList.get_arena().allocate<sprite_instance_2d>(pLayer.get_storage<sprite_component>().size());
+	std::size_t instance_count = 0;
+	std::size_t batch_start = 0;
+	const texture* batch_texture = nullptr;
+	const auto push_instance_batch = [&]()
+	{
+		if (instance_count == batch_start)
+			return;
+		render_batch_2d batch;
+		batch.rendertexture = batch_texture;
+		batch.instances = instances.subspan(batch_start, instance_count - batch_start);
+		pList.push_batch(std::move(batch));
+		batch_start = instance_count;
+	};
+
+	const texture* last_texture = nullptr;
+	const texture* last_source_texture = nullptr;
 	for (auto [id, sprite, transform] :
 		pLayer.each<sprite_component, math::transform>())
 	{
-		sprite.create_batch(transform, *this);
+		const auto sprite_handle = sprite.get_controller().get_sprite();
+		if (!sprite_handle)
+			continue;
+
+		// Skip anything outside of the view before any geometry is generated.
+		if (!sprite.update_world_aabb(transform, pixel_scale).intersect(mRender_view))
+		{
+			++stats.sprites_culled;
+			continue;
+		}
+		++stats.sprites_drawn;
+
+		// Keep track of how much the atlas is helping.
+		const texture* current_texture = &sprite_handle->get_texture();
+		const texture* source_texture = &sprite_handle->get_source_texture();
+		if (last_texture && current_texture != last_texture)
+			++stats.texture_switches;
+		else if (last_source_texture && source_texture != last_source_texture)
+			++stats.texture_switches_saved;
+		last_texture = current_texture;
+		last_source_texture = source_texture;
+
+		// The instanced shader can't represent shear so
+		// these go through the regular path.
+		if (use_instancing && transform.shear.is_zero())
+		{
+			sprite_instance_2d& instance = instances[instance_count];
+			const texture* instance_texture = sprite.create_instance(transform, pixel_scale, instance);
+			if (!instance_texture)
+				continue;
+			if (instance_texture != batch_texture)
+			{
+				push_instance_batch();
+				batch_texture = instance_texture;
+			}
+			++instance_count;
+		}
+		else
+		{
+			// Keep the draw order. Earlier instances go first.
+			push_instance_batch();
+			if (sprite.create_batch(transform, pixel_scale, pList))
+				++stats.sprites_reused;
+		}
 	}
+	push_instance_batch();
 
-	sort_batches();
+	// Sorting is part of building so it happens on the worker too.
+	sort_batches(pList.mBatches);
+}
 
-	for (const auto& i : mBatches)
-		mGraphics->get_graphics_backend()->render_batch(mFramebuffer, mProjection_matrix, i);
-	mBatches.clear();
+// A chunk of tiles that is kept on the gpu until it changes.
+struct tilemap_chunk
+{
+	// Version of the tile_grid chunk this was built from.
+	std::uint64_t version{ 0 };
+	math::aabb bounds;
+	retained_geometry::ptr geometry;
+	// Set when the vertices were rebuilt but not uploaded yet.
+	bool needs_upload{ false };
+	// Kept until they are uploaded. If the backend can't retain
+	// geometry, these are drawn directly instead.
+	std::vector<packed_vertex_2d> vertices;
+	std::vector<unsigned int> indexes;
+};
+
+// Layer component holding the render data of all chunks in a tilemap layer.
+struct tilemap_chunk_cache
+{
+	std::unordered_map<std::uint64_t, tilemap_chunk> chunks;
+};
+
+// Generates the geometry of a chunk. Uploading is left to submit.
+static void build_chunk(const core::tile_grid::chunk& pSource, const tileset& pTileset, tilemap_chunk& pChunk)
+{
+	pChunk.vertices.clear();
+	pChunk.vertices.reserve(pSource.tile_count * 4);
+	for (std::size_t i = 0; i < pSource.cells.size(); i++)
+	{
+		const core::tile_cell& cell = pSource.cells[i];
+		if (!cell.is_occupied())
+			continue;
+		quad_vertices quad;
+		quad.set_rect(math::rect(math::vec2(pSource.get_tile_position(i)), math::vec2(1, 1)));
+		quad.set_uv(core::get_tile_uvrect(pTileset, cell.get_uv()));
+		pChunk.vertices.insert(pChunk.vertices.end(), std::begin(quad.corners), std::end(quad.corners));
+	}
+
+	pChunk.indexes.resize(pChunk.vertices.size() / 4 * 6);
+	for (std::size_t i = 0; i < pChunk.vertices.size() / 4; i++)
+	{
+		quad_indicies quad;
+		quad.set_start_index(i * 4);
+		std::copy(std::begin(quad.corners), std::end(quad.corners), pChunk.indexes.begin() + i * 6);
+	}
+
+	const math::vec2 chunk_min{ pSource.position * core::tilemap_chunk_size };
+	pChunk.bounds = math::aabb{ chunk_min, chunk_min + math::vec2(core::tilemap_chunk_size, core::tilemap_chunk_size) };
+	pChunk.version = pSource.version;
+	pChunk.needs_upload = true;
 }
 
-void renderer::render_tilemap(core::layer& pLayer)
+void renderer::build_tilemap(core::layer& pLayer, render_command_list& pList)
 {
 	core::tilemap_info* info = pLayer.layer_components.get<core::tilemap_info>();
-	if (!info || !info->tileset.is_valid())
+	const core::tile_grid* grid = pLayer.layer_components.get<core::tile_grid>();
+	if (!info || !grid || !info->tileset.is_valid())
 		return;
 
-	// Update the indexes of all the vertices.
-	std::size_t index = 0;
-	for (auto [id, indexes] : pLayer.each<quad_indicies>())
+	auto cache = pLayer.layer_components.get<tilemap_chunk_cache>();
+	if (!cache)
+		cache = pLayer.layer_components.insert(tilemap_chunk_cache{});
+
+	// Drop the chunks that no longer have any tiles.
+	for (auto iter = cache->chunks.begin(); iter != cache->chunks.end();)
 	{
-		indexes.set_start_index(index++ * 4);
+		if (grid->get_chunks().count(iter->first) == 0)
+		{
+			if (iter->second.geometry)
+				pList.mReleased_geometry.push_back(std::move(iter->second.geometry));
+			iter = cache->chunks.erase(iter);
+		}
+		else
+			++iter;
 	}
-	
-	render_batch_2d batch;
-	batch.rendertexture = &info->tileset->get_texture();
-
-	// This is a fairly dirty optimization that allows us to use the
-	// component memory storage directly without copying anything over to be rendered.
-	// The performance improvement was substantial enough to warrent this optimization early on.
-	batch.use_indirect_source = true;
-	auto idx_raw = pLayer.get_storage<quad_indicies>().get_const_raw();
-	auto verts_raw = pLayer.get_storage<quad_vertices>().get_const_raw();
-	if (!idx_raw.empty() && !verts_raw.empty())
-	{
-		batch.indexes_indirect = util::span{ &idx_raw[0].corners[0], idx_raw.size() * 6 };
-		batch.vertices_indirect = util::span{ &verts_raw[0].corners[0], verts_raw.size() * 4 };
-		mGraphics->get_graphics_backend()->render_batch(mFramebuffer, mProjection_matrix, batch);
+
+	pList.mTileset_texture = &info->tileset->get_texture();
+	for (const auto& [key, source] : grid->get_chunks())
+	{
+		tilemap_chunk& chunk = cache->chunks[key];
+
+		// Only chunks that have been modified are rebuilt. Everything
+		// else is already on the gpu.
+		if (chunk.version != source.version)
+			build_chunk(source, *info->tileset, chunk);
+
+		if (chunk.bounds.intersect(mRender_view))
+			pList.mTilemap_chunks.push_back(&chunk);
 	}
 }
 
+void renderer::submit(render_command_list& pList)
+{
+	auto& backend = *mGraphics->get_graphics_backend();
+
+	pList.mReleased_geometry.clear();
+
+	backend.begin_layer(pList.mStats.name);
+
+	for (const auto& i : pList.mBatches)
+		backend.render_batch(pList.mFramebuffer, pList.mProjection_matrix, i);
+
+	for (tilemap_chunk* chunk : pList.mTilemap_chunks)
+	{
+		if (chunk->needs_upload)
+		{
+			if (!chunk->geometry)
+				chunk->geometry = backend.create_retained_geometry();
+			if (chunk->geometry)
+			{
+				chunk->geometry->update(chunk->vertices, chunk->indexes);
+				// The gpu has its own copy now.
+				chunk->vertices = {};
+				chunk->indexes = {};
+			}
+			chunk->needs_upload = false;
+		}
+
+		render_batch_2d batch;
+		batch.rendertexture = pList.mTileset_texture;
+		if (chunk->geometry)
+		{
+			batch.retained = chunk->geometry.get();
+		}
+		else
+		{
+			batch.use_indirect_source = true;
+			batch.indexes_indirect = chunk->indexes;
+			batch.vertices_indirect = chunk->vertices;
+		}
+		backend.render_batch(pList.mFramebuffer, pList.mProjection_matrix, batch);
+	}
+}
+
+void renderer::begin_frame()
+{
+	// Upload any atlas pages that changed since the last frame.
+	mGraphics->get_sprite_atlas().update_textures();
+	// Spread texture uploads from loading assets over several frames.
+	mGraphics->get_graphics_backend()->process_uploads();
+	// Everything from the last frame has been submitted so its
+	// render data can be thrown away all at once.
+	for (auto& i : mCommand_lists)
+		i.mArena.reset();
+}
+
 void renderer::render_layer(core::layer& pLayer)
 {
-	mProjection_matrix = math::ortho(mRender_view);
-	render_sprites(pLayer);
-	render_tilemap(pLayer);
+	// Always submitted here. This is used for one off renders
+	// that are expected to be finished when it returns.
+	wait_for_submission();
+	begin_frame();
+	if (mCommand_lists.empty())
+		mCommand_lists.emplace_back();
+	render_command_list& list = mCommand_lists.front();
+	build_layer(pLayer, list);
+	submit(list);
+	mLast_layer_stats = list.mStats;
+	mScene_stats.resize(1);
+	mScene_stats.front() = mLast_layer_stats;
 }
 
 void renderer::render_scene(core::scene& pScene)
 {
+	// The lists and the context are still in use until the last frame is done.
+	wait_for_submission();
+	begin_frame();
+	mScene_layers.clear();
 	for (auto& i : pScene)
-		render_layer(i);
+		mScene_layers.push_back(&i);
+	if (mCommand_lists.size() < mScene_layers.size())
+		mCommand_lists.resize(mScene_layers.size());
+
+	// Every layer has its own components and list so
+	// they can all be built at the same time.
+	const auto build = [&](std::size_t pIndex)
+	{
+		build_layer(*mScene_layers[pIndex], mCommand_lists[pIndex]);
+	};
+	if (util::thread_pool* pool = mGraphics->get_thread_pool())
+		pool->parallel_for(mScene_layers.size(), build);
+	else
+		for (std::size_t i = 0; i < mScene_layers.size(); i++)
+			build(i);
+
+	// The stats are known once the lists are built so they
+	// don't have to wait for the submission.
+	// Assign over the old entries so their memory gets reused.
+	mScene_stats.resize(mScene_layers.size());
+	for (std::size_t i = 0; i < mScene_layers.size(); i++)
+		mScene_stats[i] = mCommand_lists[i].mStats;
+	if (!mScene_stats.empty())
+		mLast_layer_stats = mScene_stats.back();
+
+	if (mSubmission_thread)
+	{
+		if (!mScene_layers.empty())
+			mSubmission_thread->start(*this, mScene_layers.size());
+		return;
+	}
+	for (std::size_t i = 0; i < mScene_layers.size(); i++)
+		submit(mCommand_lists[i]);
+}
+
+void renderer::set_threaded_submission(bool pEnabled)
+{
+	if (pEnabled == is_threaded_submission())
+		return;
+	if (pEnabled)
+	{
+		mSubmission_thread = std::make_unique<submission_thread>();
+	}
+	else
+	{
+		wait_for_submission();
+		mSubmission_thread.reset();
+	}
+}
+
+bool renderer::is_threaded_submission() const noexcept
+{
+	return mSubmission_thread != nullptr;
+}
+
+void renderer::wait_for_submission()
+{
+	if (mSubmission_thread)
+		mSubmission_thread->wait();
 }
 
 void renderer::update_animations(core::scene& pScene, float pDelta)
@@ -175,13 +525,27 @@ float renderer::get_pixel_scale() const noexcept
 	return 1.f / ppusq;
 }
 
-void renderer::sort_batches()
+void renderer::reset_layer_stats(core::layer& pLayer, layer_render_stats& pStats) const
+{
+	// Reset the members individually so the name keeps its memory.
+	pStats.name = pLayer.get_name();
+	pStats.sprites_drawn = 0;
+	pStats.sprites_culled = 0;
+	pStats.texture_switches = 0;
+	pStats.texture_switches_saved = 0;
+	pStats.sprites_reused = 0;
+}
+
+void renderer::sort_batches(std::vector<render_batch_2d>& pBatches)
 {
-	std::sort(mBatches.begin(), mBatches.end(),
-		[](const render_batch_2d& l, const render_batch_2d& r)->bool
+	const auto compare = [](const render_batch_2d& l, const render_batch_2d& r)->bool
 	{
 		return l.depth > r.depth;
-	});
+	};
+	// Batches of the same depth have to stay in draw order. Usually
+	// nothing needs to move so skip the stable sort's buffer.
+	if (!std::is_sorted(pBatches.begin(), pBatches.end(), compare))
+		std::stable_sort(pBatches.begin(), pBatches.end(), compare);
 }
 
 } // namespace wge::graphics
@@ -0,0 +1,351 @@
+#include <wge/graphics/graphics_backend.hpp>
+#include <wge/graphics/software_framebuffer.hpp>
+#include <wge/util/thread_pool.hpp>
+#include "software_rasterizer.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace wge::graphics
+{
+
+// Keeps a copy of the image to sample from.
+class software_texture_impl :
+	public texture_impl
+{
+public:
+	virtual void create_from_image(const image& pImage) override
+	{
+		mImage = pImage;
+	}
+
+	virtual void set_smooth(bool pSmooth) override
+	{
+		mSmooth = pSmooth;
+	}
+
+	virtual bool is_smooth() const override
+	{
+		return mSmooth;
+	}
+
+	// Returns false if there is nothing to sample.
+	bool get_raster_texture(raster_texture& pResult) const noexcept
+	{
+		if (mImage.empty())
+			return false;
+		pResult.pixels = mImage.get_raw().data();
+		pResult.width = mImage.get_width();
+		pResult.height = mImage.get_height();
+		pResult.smooth = mSmooth;
+		return true;
+	}
+
+private:
+	bool mSmooth{ false };
+	image mImage;
+};
+
+class software_retained_geometry :
+	public retained_geometry
+{
+public:
+	virtual void update(util::span<const packed_vertex_2d> pVertices, util::span<const unsigned int> pIndexes) override
+	{
+		mVertices.assign(pVertices.begin(), pVertices.end());
+		mIndexes.assign(pIndexes.begin(), pIndexes.end());
+	}
+
+	virtual std::size_t get_vertex_count() const override
+	{
+		return mVertices.size();
+	}
+
+	virtual std::size_t get_index_count() const override
+	{
+		return mIndexes.size();
+	}
+
+	virtual bool read_back(std::vector<packed_vertex_2d>& pVertices, std::vector<unsigned int>& pIndexes) const override
+	{
+		pVertices = mVertices;
+		pIndexes = mIndexes;
+		return true;
+	}
+
+	util::span<const packed_vertex_2d> get_vertices() const noexcept
+	{
+		return mVertices;
+	}
+
+	util::span<const unsigned int> get_indexes() const noexcept
+	{
+		return mIndexes;
+	}
+
+private:
+	std::vector<packed_vertex_2d> mVertices;
+	std::vector<unsigned int> mIndexes;
+};
+
+// Renders on the cpu into software_framebuffers.
+// The framebuffer is split into tiles that are drawn in parallel. Every tile
+// draws its primitives in order so the result is the same as drawing
+// everything on one thread.
+class software_backend :
+	public graphics_backend
+{
+public:
+	static constexpr int tile_size = 64;
+
+	virtual void initialize() override
+	{
+	}
+
+	virtual bool supports_instancing() const override
+	{
+		return true;
+	}
+
+	virtual void render_batch(const framebuffer::ptr& mFramebuffer, const math::mat44& pProjection, const render_batch_2d& pBatch) override
+	{
+		if (!mFramebuffer || pBatch.empty())
+			return;
+		auto target_framebuffer = std::dynamic_pointer_cast<software_framebuffer>(mFramebuffer);
+		if (!target_framebuffer || target_framebuffer->get_image().empty())
+			return;
+
+		image& target_image = target_framebuffer->get_image();
+		raster_target target;
+		target.pixels = target_image.get_raw().data();
+		target.width = target_image.get_width();
+		target.height = target_image.get_height();
+
+		raster_texture texture;
+		bool has_texture = false;
+		if (pBatch.rendertexture)
+		{
+			auto impl = std::dynamic_pointer_cast<software_texture_impl>(pBatch.rendertexture->get_implementation());
+			has_texture = impl && impl->get_raster_texture(texture);
+		}
+
+		primitive_type type = pBatch.type;
+		util::span<const unsigned int> indexes;
+		mVertices.clear();
+		if (pBatch.retained)
+		{
+			auto geometry = dynamic_cast<const software_retained_geometry*>(pBatch.retained);
+			if (!geometry)
+				return;
+			for (const auto& i : geometry->get_vertices())
+				mVertices.push_back(project(pProjection, target, i.position, i.get_uv(), i.color));
+			indexes = geometry->get_indexes();
+			type = primitive_type::triangles;
+		}
+		else if (!pBatch.instances.empty())
+		{
+			expand_instances(pProjection, target, pBatch.instances);
+			indexes = mInstance_indexes;
+			type = primitive_type::triangles;
+		}
+		else if (pBatch.use_indirect_source)
+		{
+			for (const auto& i : pBatch.vertices_indirect)
+				mVertices.push_back(project(pProjection, target, i.position, i.get_uv(), i.color));
+			indexes = pBatch.indexes_indirect;
+		}
+		else
+		{
+			for (const auto& i : pBatch.vertices)
+				mVertices.push_back(project(pProjection, target, i.position, i.uv, i.color));
+			indexes = pBatch.indexes;
+		}
+
+		assemble(type, indexes);
+		bin(target);
+		draw_tiles(target, has_texture ? &texture : nullptr);
+	}
+
+	virtual framebuffer::ptr create_framebuffer() override
+	{
+		return std::make_shared<software_framebuffer>(200, 200); // Some arbitrary default
+	}
+
+	virtual texture_impl::ptr create_texture_impl() override
+	{
+		return std::make_shared<software_texture_impl>();
+	}
+
+	virtual retained_geometry::ptr create_retained_geometry() override
+	{
+		return std::make_shared<software_retained_geometry>();
+	}
+
+private:
+	// Projects a vertex into pixel coordinates with y pointing down.
+	static raster_vertex project(const math::mat44& pProjection, const raster_target& pTarget,
+		const math::vec2& pPosition, const math::vec2& pUV, const color& pColor) noexcept
+	{
+		const auto& m = pProjection.m;
+		const float x = m[0][0] * pPosition.x + m[1][0] * pPosition.y + m[3][0];
+		const float y = m[0][1] * pPosition.x + m[1][1] * pPosition.y + m[3][1];
+		const float w = m[0][3] * pPosition.x + m[1][3] * pPosition.y + m[3][3];
+		const float inverse_w = w != 0 ? 1.f / w : 1.f;
+
+		raster_vertex result;
+		result.x = (x * inverse_w * 0.5f + 0.5f) * static_cast<float>(pTarget.width);
+		result.y = (0.5f - y * inverse_w * 0.5f) * static_cast<float>(pTarget.height);
+		result.u = pUV.x;
+		result.v = pUV.y;
+		result.r = pColor.r;
+		result.g = pColor.g;
+		result.b = pColor.b;
+		result.a = pColor.a;
+		return result;
+	}
+
+	// Same math as the instanced vertex shader in the OpenGL backend.
+	void expand_instances(const math::mat44& pProjection, const raster_target& pTarget,
+		util::span<const sprite_instance_2d> pInstances)
+	{
+		mInstance_indexes.clear();
+		for (const auto& i : pInstances)
+		{
+			const float s = std::sin(i.rotation);
+			const float c = std::cos(i.rotation);
+			const math::vec2 uv_min{ unpack_unorm16(i.uv_rect[0]), unpack_unorm16(i.uv_rect[1]) };
+			const math::vec2 uv_max{ unpack_unorm16(i.uv_rect[2]), unpack_unorm16(i.uv_rect[3]) };
+			const auto start = static_cast<unsigned int>(mVertices.size());
+			for (int corner_index = 0; corner_index < 4; corner_index++)
+			{
+				const math::vec2 corner{ static_cast<float>(corner_index % 2), static_cast<float>(corner_index / 2) };
+				const math::vec2 local = (corner * i.size - i.anchor) * i.scale;
+				const math::vec2 world = i.position + math::vec2{ local.x * c - local.y * s, local.x * s + local.y * c };
+				const math::vec2 uv = uv_min + (uv_max - uv_min) * corner;
+				mVertices.push_back(project(pProjection, pTarget, world, uv, i.color));
+			}
+			// The corners are in triangle strip order.
+			for (unsigned int index : { 0u, 1u, 2u, 2u, 1u, 3u })
+				mInstance_indexes.push_back(start + index);
+		}
+	}
+
+	void assemble(primitive_type pType, util::span<const unsigned int> pIndexes)
+	{
+		mTriangles.clear();
+		mLines.clear();
+		const auto add_triangle = [&](unsigned int pA, unsigned int pB, unsigned int pC)
+		{
+			if (pA >= mVertices.size() || pB >= mVertices.size() || pC >= mVertices.size())
+				return;
+			raster_triangle triangle;
+			if (triangle.setup(mVertices[pA], mVertices[pB], mVertices[pC]))
+				mTriangles.push_back(triangle);
+		};
+
+		switch (pType)
+		{
+		case primitive_type::triangles:
+			for (std::size_t i = 0; i + 2 < pIndexes.size(); i += 3)
+				add_triangle(pIndexes[i], pIndexes[i + 1], pIndexes[i + 2]);
+			break;
+		case primitive_type::triangle_fan:
+			for (std::size_t i = 1; i + 1 < pIndexes.size(); i++)
+				add_triangle(pIndexes[0], pIndexes[i], pIndexes[i + 1]);
+			break;
+		case primitive_type::linestrip:
+			for (std::size_t i = 0; i + 1 < pIndexes.size(); i++)
+				if (pIndexes[i] < mVertices.size() && pIndexes[i + 1] < mVertices.size())
+					mLines.push_back({ pIndexes[i], pIndexes[i + 1] });
+			break;
+		}
+	}
+
+	// Sort the primitives into the tiles they touch.
+	void bin(const raster_target& pTarget)
+	{
+		mTile_columns = (pTarget.width + tile_size - 1) / tile_size;
+		const int tile_rows = (pTarget.height + tile_size - 1) / tile_size;
+		mBins.resize(static_cast<std::size_t>(mTile_columns) * static_cast<std::size_t>(tile_rows));
+		for (auto& i : mBins)
+			i.clear();
+
+		const raster_rect screen{ 0, 0, pTarget.width, pTarget.height };
+		const auto add = [&](const raster_rect& pBounds, std::uint32_t pIndex)
+		{
+			const raster_rect bounds = pBounds.intersect(screen);
+			if (bounds.empty())
+				return;
+			for (int y = bounds.min_y / tile_size; y <= (bounds.max_y - 1) / tile_size; y++)
+				for (int x = bounds.min_x / tile_size; x <= (bounds.max_x - 1) / tile_size; x++)
+					mBins[static_cast<std::size_t>(y) * mTile_columns + x].push_back(pIndex);
+		};
+
+		for (std::size_t i = 0; i < mTriangles.size(); i++)
+			add(mTriangles[i].bounds, static_cast<std::uint32_t>(i));
+
+		for (std::size_t i = 0; i < mLines.size(); i++)
+		{
+			const raster_vertex& a = mVertices[mLines[i].first];
+			const raster_vertex& b = mVertices[mLines[i].second];
+			const auto to_pixel = [](float pValue)
+			{
+				return static_cast<int>(std::floor(std::clamp(pValue, -raster_coordinate_limit, raster_coordinate_limit)));
+			};
+			const raster_rect bounds{
+				to_pixel(std::min(a.x, b.x)), to_pixel(std::min(a.y, b.y)),
+				to_pixel(std::max(a.x, b.x)) + 1, to_pixel(std::max(a.y, b.y)) + 1 };
+			add(bounds, static_cast<std::uint32_t>(i));
+		}
+
+		mActive_tiles.clear();
+		for (std::size_t i = 0; i < mBins.size(); i++)
+			if (!mBins[i].empty())
+				mActive_tiles.push_back(i);
+	}
+
+	void draw_tiles(const raster_target& pTarget, const raster_texture* pTexture)
+	{
+		// Tiles never overlap so they can all be drawn at the same time.
+		mWorkers.parallel_for(mActive_tiles.size(), [&](std::size_t pIndex)
+		{
+			const std::size_t tile = mActive_tiles[pIndex];
+			const int tile_x = static_cast<int>(tile % mTile_columns) * tile_size;
+			const int tile_y = static_cast<int>(tile / mTile_columns) * tile_size;
+			const raster_rect clip = raster_rect{ tile_x, tile_y, tile_x + tile_size, tile_y + tile_size }
+				.intersect(raster_rect{ 0, 0, pTarget.width, pTarget.height });
+
+			if (!mTriangles.empty())
+			{
+				for (std::uint32_t i : mBins[tile])
+					rasterize_triangle(mTriangles[i], pTexture, pTarget, clip);
+			}
+			else
+			{
+				for (std::uint32_t i : mBins[tile])
+					rasterize_line(mVertices[mLines[i].first], mVertices[mLines[i].second], pTexture, pTarget, clip);
+			}
+		});
+	}
+
+private:
+	util::thread_pool mWorkers;
+
+	// Everything below is reused between batches to avoid reallocating.
+	std::vector<raster_vertex> mVertices;
+	std::vector<unsigned int> mInstance_indexes;
+	std::vector<raster_triangle> mTriangles;
+	std::vector<std::pair<unsigned int, unsigned int>> mLines;
+	// Primitive indexes for each tile.
+	std::vector<std::vector<std::uint32_t>> mBins;
+	std::vector<std::size_t> mActive_tiles;
+	int mTile_columns{ 0 };
+};
+
+graphics_backend::ptr create_software_backend()
+{
+	return std::make_shared<software_backend>();
+}
+
+} // namespace wge::graphics
@@ -0,0 +1,374 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WGE_SOFTWARE_RASTERIZER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace wge::graphics
+{
+
+// Plain data the rasterizer works with so the inner loops don't
+// need to know anything about batches, textures, or framebuffers.
+
+// A vertex that has already been projected to pixel coordinates.
+// y points down with (0, 0) being the top-left of the framebuffer.
+struct raster_vertex
+{
+	float x, y;
+	float u, v;
+	float r, g, b, a;
+};
+
+// Read-only view of RGBA8 pixels.
+struct raster_texture
+{
+	const std::uint8_t* pixels = nullptr;
+	int width{ 0 }, height{ 0 };
+	bool smooth{ false };
+};
+
+// The RGBA8 pixels being drawn to.
+struct raster_target
+{
+	std::uint8_t* pixels = nullptr;
+	int width{ 0 }, height{ 0 };
+};
+
+// A pixel rect in the range [min, max).
+struct raster_rect
+{
+	int min_x{ 0 }, min_y{ 0 }, max_x{ 0 }, max_y{ 0 };
+
+	bool empty() const noexcept
+	{
+		return min_x >= max_x || min_y >= max_y;
+	}
+
+	raster_rect intersect(const raster_rect& pOther) const noexcept
+	{
+		return{
+			std::max(min_x, pOther.min_x), std::max(min_y, pOther.min_y),
+			std::min(max_x, pOther.max_x), std::min(max_y, pOther.max_y) };
+	}
+};
+
+// Vertex positions are snapped to 1/16th of a pixel and clamped to this
+// range so the edge functions can be evaluated exactly with doubles.
+// Exact edge values are what make the fill rule reliable. Shared edges
+// never leave gaps or draw a pixel twice.
+constexpr float raster_subpixel_steps = 16;
+constexpr float raster_coordinate_limit = 262144;
+
+inline float snap_raster_coordinate(float pValue) noexcept
+{
+	const float clamped = std::clamp(pValue, -raster_coordinate_limit, raster_coordinate_limit);
+	return std::round(clamped * raster_subpixel_steps) / raster_subpixel_steps;
+}
+
+// A triangle ready to be drawn. Each edge function is
+// a * x + b * y + c and is positive on the inside.
+struct raster_triangle
+{
+	raster_vertex vertices[3];
+	double edge_a[3], edge_b[3], edge_c[3];
+	// Edges that own the pixels exactly on them (top-left fill rule).
+	bool edge_inclusive[3];
+	float inverse_area{ 0 };
+	raster_rect bounds;
+
+	// Returns false if the triangle has no area.
+	bool setup(const raster_vertex& pV0, const raster_vertex& pV1, const raster_vertex& pV2) noexcept
+	{
+		vertices[0] = pV0;
+		vertices[1] = pV1;
+		vertices[2] = pV2;
+		for (auto& i : vertices)
+		{
+			i.x = snap_raster_coordinate(i.x);
+			i.y = snap_raster_coordinate(i.y);
+		}
+
+		// Make the winding consistent so inside is always positive.
+		double area = edge(vertices[0], vertices[1], vertices[2].x, vertices[2].y);
+		if (area < 0)
+		{
+			std::swap(vertices[1], vertices[2]);
+			area = -area;
+		}
+		if (!(area > 0))
+			return false;
+		inverse_area = static_cast<float>(1. / area);
+
+		// Edge i is opposite of vertex i so the edge
+		// functions are also the barycentric weights.
+		for (int i = 0; i < 3; i++)
+		{
+			const raster_vertex& start = vertices[(i + 1) % 3];
+			const raster_vertex& end = vertices[(i + 2) % 3];
+			edge_a[i] = static_cast<double>(start.y) - end.y;
+			edge_b[i] = static_cast<double>(end.x) - start.x;
+			edge_c[i] = static_cast<double>(start.x) * end.y - static_cast<double>(start.y) * end.x;
+			// With y pointing down, a top edge is horizontal and goes
+			// right to left. A left edge goes downwards.
+			edge_inclusive[i] = (edge_a[i] == 0 && edge_b[i] < 0) || edge_a[i] < 0;
+		}
+
+		// Pixel centers are at +0.5 so only pixels whose centers can be inside are included.
+		const float min_x = std::min({ vertices[0].x, vertices[1].x, vertices[2].x });
+		const float min_y = std::min({ vertices[0].y, vertices[1].y, vertices[2].y });
+		const float max_x = std::max({ vertices[0].x, vertices[1].x, vertices[2].x });
+		const float max_y = std::max({ vertices[0].y, vertices[1].y, vertices[2].y });
+		bounds.min_x = static_cast<int>(std::floor(min_x - 0.5f)) + 1;
+		bounds.min_y = static_cast<int>(std::floor(min_y - 0.5f)) + 1;
+		bounds.max_x = static_cast<int>(std::floor(max_x - 0.5f)) + 1;
+		bounds.max_y = static_cast<int>(std::floor(max_y - 0.5f)) + 1;
+		return true;
+	}
+
+	static double edge(const raster_vertex& pA, const raster_vertex& pB, double pX, double pY) noexcept
+	{
+		return (static_cast<double>(pA.y) - pB.y) * pX + (static_cast<double>(pB.x) - pA.x) * pY
+			+ (static_cast<double>(pA.x) * pB.y - static_cast<double>(pA.y) * pB.x);
+	}
+};
+
+namespace detail
+{
+
+inline float wrap_coord(float pValue) noexcept
+{
+	return pValue - std::floor(pValue);
+}
+
+inline int wrap_texel(int pValue, int pSize) noexcept
+{
+	const int result = pValue % pSize;
+	return result < 0 ? result + pSize : result;
+}
+
+// Samples with repeat wrapping like the OpenGL backend.
+inline void sample(const raster_texture& pTexture, float pU, float pV, float pResult[4]) noexcept
+{
+	const auto texel = [&](int pX, int pY) -> const std::uint8_t*
+	{
+		return pTexture.pixels + (static_cast<std::size_t>(pY) * static_cast<std::size_t>(pTexture.width)
+			+ static_cast<std::size_t>(pX)) * 4;
+	};
+
+	if (!pTexture.smooth)
+	{
+		const int x = std::min(static_cast<int>(wrap_coord(pU) * pTexture.width), pTexture.width - 1);
+		const int y = std::min(static_cast<int>(wrap_coord(pV) * pTexture.height), pTexture.height - 1);
+		const std::uint8_t* p = texel(x, y);
+		for (int i = 0; i < 4; i++)
+			pResult[i] = p[i] * (1.f / 255.f);
+		return;
+	}
+
+	// Bilinear filtering between the 4 closest texels.
+	const float x = pU * pTexture.width - 0.5f;
+	const float y = pV * pTexture.height - 0.5f;
+	const float fx = std::floor(x);
+	const float fy = std::floor(y);
+	const float tx = x - fx;
+	const float ty = y - fy;
+	const int x0 = wrap_texel(static_cast<int>(fx), pTexture.width);
+	const int y0 = wrap_texel(static_cast<int>(fy), pTexture.height);
+	const int x1 = wrap_texel(x0 + 1, pTexture.width);
+	const int y1 = wrap_texel(y0 + 1, pTexture.height);
+	const std::uint8_t* p00 = texel(x0, y0);
+	const std::uint8_t* p10 = texel(x1, y0);
+	const std::uint8_t* p01 = texel(x0, y1);
+	const std::uint8_t* p11 = texel(x1, y1);
+	for (int i = 0; i < 4; i++)
+	{
+		const float top = p00[i] + (p10[i] - p00[i]) * tx;
+		const float bottom = p01[i] + (p11[i] - p01[i]) * tx;
+		pResult[i] = (top + (bottom - top) * ty) * (1.f / 255.f);
+	}
+}
+
+inline std::uint8_t to_unorm8(float pValue) noexcept
+{
+	return static_cast<std::uint8_t>(std::clamp(pValue, 0.f, 1.f) * 255.f + 0.5f);
+}
+
+// Standard alpha blending (src_alpha, one_minus_src_alpha) for every channel.
+inline void blend(std::uint8_t* pDest, const float pColor[4]) noexcept
+{
+	const float alpha = std::clamp(pColor[3], 0.f, 1.f);
+	const float inverse_alpha = 1.f - alpha;
+	for (int i = 0; i < 4; i++)
+		pDest[i] = to_unorm8(pColor[i] * alpha + pDest[i] * (1.f / 255.f) * inverse_alpha);
+}
+
+// Interpolate the vertex attributes with the barycentric weights and write the pixel.
+inline void shade(const raster_triangle& pTriangle, const raster_texture* pTexture,
+	float pW0, float pW1, float pW2, std::uint8_t* pDest) noexcept
+{
+	const raster_vertex& v0 = pTriangle.vertices[0];
+	const raster_vertex& v1 = pTriangle.vertices[1];
+	const raster_vertex& v2 = pTriangle.vertices[2];
+	const float b0 = pW0 * pTriangle.inverse_area;
+	const float b1 = pW1 * pTriangle.inverse_area;
+	const float b2 = pW2 * pTriangle.inverse_area;
+
+	float color[4] = {
+		v0.r * b0 + v1.r * b1 + v2.r * b2,
+		v0.g * b0 + v1.g * b1 + v2.g * b2,
+		v0.b * b0 + v1.b * b1 + v2.b * b2,
+		v0.a * b0 + v1.a * b1 + v2.a * b2,
+	};
+
+	if (pTexture)
+	{
+		float texel[4];
+		sample(*pTexture, v0.u * b0 + v1.u * b1 + v2.u * b2, v0.v * b0 + v1.v * b1 + v2.v * b2, texel);
+		for (int i = 0; i < 4; i++)
+			color[i] *= texel[i];
+	}
+
+	blend(pDest, color);
+}
+
+} // namespace detail
+
+// Draw the part of a triangle that is inside of pClip.
+// Edge functions are evaluated for 4 pixels at a time when SSE2 is available.
+inline void rasterize_triangle(const raster_triangle& pTriangle, const raster_texture* pTexture,
+	const raster_target& pTarget, const raster_rect& pClip) noexcept
+{
+	const raster_rect rect = pTriangle.bounds.intersect(pClip);
+	if (rect.empty())
+		return;
+
+	const double* a = pTriangle.edge_a;
+	const double* b = pTriangle.edge_b;
+	const double* c = pTriangle.edge_c;
+	const bool* inclusive = pTriangle.edge_inclusive;
+
+#ifdef WGE_SOFTWARE_RASTERIZER_SSE2
+	// Each register holds 2 pixels so there are 2 of them for every edge.
+	__m128d step_low[3], step_high[3], step_4x[3], inclusive_mask[3];
+	for (int i = 0; i < 3; i++)
+	{
+		step_low[i] = _mm_set_pd(a[i], 0);
+		step_high[i] = _mm_set_pd(a[i] * 3, a[i] * 2);
+		step_4x[i] = _mm_set1_pd(a[i] * 4);
+		inclusive_mask[i] = _mm_castsi128_pd(_mm_set1_epi32(inclusive[i] ? -1 : 0));
+	}
+	const __m128d zero = _mm_setzero_pd();
+	const auto inside_mask = [&](const __m128d* pW) -> int
+	{
+		// Inside if every edge is positive, or zero on an inclusive edge.
+		__m128d inside = _mm_castsi128_pd(_mm_set1_epi32(-1));
+		for (int i = 0; i < 3; i++)
+		{
+			const __m128d on_edge = _mm_and_pd(_mm_cmpeq_pd(pW[i], zero), inclusive_mask[i]);
+			inside = _mm_and_pd(inside, _mm_or_pd(_mm_cmpgt_pd(pW[i], zero), on_edge));
+		}
+		return _mm_movemask_pd(inside);
+	};
+#endif
+
+	for (int y = rect.min_y; y < rect.max_y; y++)
+	{
+		const double py = y + 0.5;
+		const double px = rect.min_x + 0.5;
+		std::uint8_t* row = pTarget.pixels + static_cast<std::size_t>(y) * static_cast<std::size_t>(pTarget.width) * 4;
+
+		int x = rect.min_x;
+#ifdef WGE_SOFTWARE_RASTERIZER_SSE2
+		__m128d w_low[3], w_high[3];
+		for (int i = 0; i < 3; i++)
+		{
+			const __m128d start = _mm_set1_pd(a[i] * px + b[i] * py + c[i]);
+			w_low[i] = _mm_add_pd(start, step_low[i]);
+			w_high[i] = _mm_add_pd(start, step_high[i]);
+		}
+
+		for (; x + 4 <= rect.max_x; x += 4)
+		{
+			const int mask = inside_mask(w_low) | (inside_mask(w_high) << 2);
+			if (mask != 0)
+			{
+				alignas(16) double w0[4], w1[4], w2[4];
+				_mm_store_pd(w0, w_low[0]);
+				_mm_store_pd(w0 + 2, w_high[0]);
+				_mm_store_pd(w1, w_low[1]);
+				_mm_store_pd(w1 + 2, w_high[1]);
+				_mm_store_pd(w2, w_low[2]);
+				_mm_store_pd(w2 + 2, w_high[2]);
+				for (int lane = 0; lane < 4; lane++)
+					if (mask & (1 << lane))
+						detail::shade(pTriangle, pTexture,
+							static_cast<float>(w0[lane]), static_cast<float>(w1[lane]), static_cast<float>(w2[lane]),
+							row + static_cast<std::size_t>(x + lane) * 4);
+			}
+
+			for (int i = 0; i < 3; i++)
+			{
+				w_low[i] = _mm_add_pd(w_low[i], step_4x[i]);
+				w_high[i] = _mm_add_pd(w_high[i], step_4x[i]);
+			}
+		}
+#endif
+
+		// Whatever is left over (or everything without SSE2).
+		for (; x < rect.max_x; x++)
+		{
+			const double cx = x + 0.5;
+			double weights[3];
+			bool inside = true;
+			for (int i = 0; i < 3; i++)
+			{
+				weights[i] = a[i] * cx + b[i] * py + c[i];
+				inside = inside && (weights[i] > 0 || (weights[i] == 0 && inclusive[i]));
+			}
+			if (inside)
+				detail::shade(pTriangle, pTexture,
+					static_cast<float>(weights[0]), static_cast<float>(weights[1]), static_cast<float>(weights[2]),
+					row + static_cast<std::size_t>(x) * 4);
+		}
+	}
+}
+
+// Draw a 1 pixel wide line. Only the pixels inside of pClip are touched.
+inline void rasterize_line(const raster_vertex& pStart, const raster_vertex& pEnd, const raster_texture* pTexture,
+	const raster_target& pTarget, const raster_rect& pClip) noexcept
+{
+	const float dx = pEnd.x - pStart.x;
+	const float dy = pEnd.y - pStart.y;
+	const int steps = static_cast<int>(std::min(std::ceil(std::max(std::abs(dx), std::abs(dy))), 65536.f));
+	for (int i = 0; i <= steps; i++)
+	{
+		const float t = steps == 0 ? 0 : static_cast<float>(i) / static_cast<float>(steps);
+		const int x = static_cast<int>(std::floor(pStart.x + dx * t));
+		const int y = static_cast<int>(std::floor(pStart.y + dy * t));
+		if (x < pClip.min_x || x >= pClip.max_x || y < pClip.min_y || y >= pClip.max_y)
+			continue;
+
+		float color[4] = {
+			pStart.r + (pEnd.r - pStart.r) * t,
+			pStart.g + (pEnd.g - pStart.g) * t,
+			pStart.b + (pEnd.b - pStart.b) * t,
+			pStart.a + (pEnd.a - pStart.a) * t,
+		};
+		if (pTexture)
+		{
+			float texel[4];
+			detail::sample(*pTexture, pStart.u + (pEnd.u - pStart.u) * t, pStart.v + (pEnd.v - pStart.v) * t, texel);
+			for (int j = 0; j < 4; j++)
+				color[j] *= texel[j];
+		}
+		detail::blend(pTarget.pixels + (static_cast<std::size_t>(y) * static_cast<std::size_t>(pTarget.width) + static_cast<std::size_t>(x)) * 4, color);
+	}
+}
+
+} // namespace wge::graphics
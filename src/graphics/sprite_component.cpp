@@ -4,63 +4,161 @@
 #include <wge/core/asset_manager.hpp>
 #include <wge/core/object.hpp>
 
+#include <algorithm>
+#include <iterator>
+
 namespace wge::graphics
 {
 
-void sprite_component::create_batch(math::transform& pTransform, renderer& pRenderer)
+bool sprite_component::create_batch(const math::transform& pTransform, float pPixel_scale, render_command_list& pList)
 {
 	if (!mController.get_sprite())
-		return;
-
-	const std::size_t current_frame = get_controller().get_frame();
+		return false;
 
 	const auto sprite = mController.get_sprite();
 
-	const texture& sprite_texture = sprite->get_texture();
+	// The geometry only needs to live until the end of the frame.
+	util::frame_arena& arena = pList.get_arena();
+	util::span<packed_vertex_2d> packed_verts = arena.allocate<packed_vertex_2d>(4);
+	util::span<unsigned int> indexes = arena.allocate<unsigned int>(6);
 
-	batch_builder batch;
-	batch.set_texture(sprite_texture);
+	const bool reused = is_vertex_cache_valid(pTransform, pPixel_scale);
+	if (!reused)
+	{
+		const std::size_t current_frame = get_controller().get_frame();
+		const sprite::frame_geometry& frame = sprite->get_frame_geometry(current_frame);
+		const math::aabb& quad = frame.quad;
+		const math::aabb& uv = frame.uv;
+
+		vertex_2d verts[4];
+		verts[0].position = quad.min;
+		verts[0].uv = uv.min;
+		verts[1].position = math::vec2(quad.max.x, quad.min.y);
+		verts[1].uv = math::vec2(uv.max.x, uv.min.y);
+		verts[2].position = quad.max;
+		verts[2].uv = uv.max;
+		verts[3].position = math::vec2(quad.min.x, quad.max.y);
+		verts[3].uv = math::vec2(uv.min.x, uv.max.y);
+
+		// Transform the vertices
+		for (int i = 0; i < 4; i++)
+		{
+			verts[i].position += mOffset;
+			verts[i].position *= pPixel_scale;
+
+			// Calc aabb of sprite before transform
+			if (i == 0)
+				mLocal_aabb = math::aabb{ verts[i].position, verts[i].position };
+			else
+				mLocal_aabb.merge(verts[i].position);
+
+			// Transform the points
+			verts[i].position = pTransform * verts[i].position;
+			mCached_vertices[i] = packed_vertex_2d{ verts[i] };
+		}
+
+		mCached_transform = pTransform;
+		mCached_sprite_version = sprite->get_frame_table_version();
+		mCached_frame = current_frame;
+		mCached_pixel_scale = pPixel_scale;
+		mCached_vertices_valid = true;
+	}
+	std::copy(std::begin(mCached_vertices), std::end(mCached_vertices), packed_verts.begin());
+
+	quad_indicies quad;
+	quad.set_start_index(0);
+	std::copy(std::begin(quad.corners), std::end(quad.corners), indexes.begin());
+
+	render_batch_2d batch;
+	batch.rendertexture = &sprite->get_texture();
+	batch.use_indirect_source = true;
+	batch.vertices_indirect = packed_verts;
+	batch.indexes_indirect = indexes;
+	pList.push_batch(std::move(batch));
+	return reused;
+}
 
-	const math::vec2 frame_size{ sprite->get_frame_size() };
+const texture* sprite_component::create_instance(const math::transform& pTransform, float pPixel_scale, sprite_instance_2d& pInstance)
+{
+	if (!mController.get_sprite())
+		return nullptr;
 
-	math::aabb uv = sprite->get_frame_uv(current_frame);
+	const std::size_t current_frame = get_controller().get_frame();
+
+	const auto sprite = mController.get_sprite();
 
-	vertex_2d verts[4];
-	verts[0].position = math::vec2(0, 0);
-	verts[0].uv = uv.min;
-	verts[1].position = { frame_size.x, 0 };
-	verts[1].uv = math::vec2(uv.max.x, uv.min.y);
-	verts[2].position = frame_size;
-	verts[2].uv = uv.max;
-	verts[3].position = { 0, frame_size.y};
-	verts[3].uv = math::vec2(uv.min.x, uv.max.y);
+	const sprite::frame_geometry& frame = sprite->get_frame_geometry(current_frame);
 
-	math::vec2 anchor = sprite->get_frame_anchor(current_frame);
+	mLocal_aabb = calc_local_aabb(current_frame, pPixel_scale);
 
-	// Transform the vertices
-	for (int i = 0; i < 4; i++)
+	pInstance.position = pTransform.position;
+	pInstance.rotation = pTransform.rotation.value();
+	pInstance.scale = pTransform.scale;
+	pInstance.size = (frame.quad.max - frame.quad.min) * pPixel_scale;
+	pInstance.anchor = math::vec2{ 0, 0 } - (frame.quad.min + mOffset) * pPixel_scale;
+	pInstance.set_uv_rect(frame.uv);
+
+	return &sprite->get_texture();
+}
+
+const math::aabb& sprite_component::update_world_aabb(const math::transform& pTransform, float pPixel_scale)
+{
+	if (!mController.get_sprite())
 	{
-		verts[i].position += mOffset - anchor;
-		verts[i].position *= pRenderer.get_pixel_scale();
-		
-		// Calc aabb of sprite before transform
-		if (i == 0)
-			mLocal_aabb = math::aabb{ verts[i].position, verts[i].position };
-		else
-			mLocal_aabb.merge(verts[i].position);
-
-		// Transform the points
-		verts[i].position = pTransform * verts[i].position;
+		mWorld_aabb_valid = false;
+		mWorld_aabb = math::aabb{};
+		return mWorld_aabb;
 	}
 
-	batch.add_quad(verts);
+	// The local bounds only depend on these and the offset, which
+	// invalidates the cache itself, so they don't need recalculating to compare.
+	const std::size_t frame = get_controller().get_frame();
+	const std::uint64_t sprite_version = mController.get_sprite()->get_frame_table_version();
+	const bool unchanged = mWorld_aabb_valid
+		&& mWorld_aabb_frame == frame
+		&& mWorld_aabb_sprite_version == sprite_version
+		&& mWorld_aabb_pixel_scale == pPixel_scale
+		&& pTransform == mWorld_aabb_transform;
+	if (unchanged)
+		return mWorld_aabb;
+
+	const math::aabb local = calc_local_aabb(frame, pPixel_scale);
+	mLocal_aabb = local;
+
+	// Transform all the corners since rotation can swap them around.
+	mWorld_aabb.min = mWorld_aabb.max = pTransform * local.point(0);
+	for (std::size_t i = 1; i < 4; i++)
+		mWorld_aabb.merge(pTransform * local.point(i));
+
+	mWorld_aabb_transform = pTransform;
+	mWorld_aabb_sprite_version = sprite_version;
+	mWorld_aabb_frame = frame;
+	mWorld_aabb_pixel_scale = pPixel_scale;
+	mWorld_aabb_valid = true;
+	return mWorld_aabb;
+}
 
-	pRenderer.push_batch(batch.finalize());
+math::aabb sprite_component::calc_local_aabb(std::size_t pFrame, float pPixel_scale) const
+{
+	const math::aabb& quad = mController.get_sprite()->get_frame_geometry(pFrame).quad;
+	return{ (quad.min + mOffset) * pPixel_scale, (quad.max + mOffset) * pPixel_scale };
+}
+
+bool sprite_component::is_vertex_cache_valid(const math::transform& pTransform, float pPixel_scale) const noexcept
+{
+	const auto& sprite = mController.get_sprite();
+	return mCached_vertices_valid
+		&& mCached_sprite_version == sprite->get_frame_table_version()
+		&& mCached_frame == mController.get_frame()
+		&& mCached_pixel_scale == pPixel_scale
+		&& pTransform == mCached_transform;
 }
 
 void sprite_component::set_offset(const math::vec2& pOffset) noexcept
 {
 	mOffset = pOffset;
+	mCached_vertices_valid = false;
+	mWorld_aabb_valid = false;
 }
 
 math::vec2 sprite_component::get_offset() const noexcept
@@ -20,35 +20,53 @@ texture_impl::ptr texture::get_implementation() const noexcept
 
 void texture::set_image(image&& pImage)
 {
-	mImage = std::move(pImage);
-	update_impl_image();
+	set_image(std::make_shared<const image>(std::move(pImage)));
 }
 
 void texture::set_image(const image& pImage)
 {
-	mImage = pImage;
+	set_image(std::make_shared<const image>(pImage));
+}
+
+void texture::set_image(std::shared_ptr<const image> pImage)
+{
+	mImage = std::move(pImage);
+	mSize = mImage ? mImage->get_size() : math::ivec2{ 0, 0 };
 	update_impl_image();
 }
 
+void texture::set_residency(image_residency pResidency) noexcept
+{
+	mResidency = pResidency;
+	if (mResidency == image_residency::discard && mImpl)
+		mImage.reset();
+}
+
+image_residency texture::get_residency() const noexcept
+{
+	return mResidency;
+}
+
 int texture::get_width() const noexcept
 {
-	return mImage.get_width();
+	return mSize.x;
 }
 
 int texture::get_height() const noexcept
 {
-	return mImage.get_height();
+	return mSize.y;
 }
 
 math::ivec2 texture::get_size() const noexcept
 {
-	return mImage.get_size();
+	return mSize;
 }
 
 void texture::set_smooth(bool pEnabled) noexcept
 {
 	mSmooth = pEnabled;
-	mImpl->set_smooth(mSmooth);
+	if (mImpl)
+		mImpl->set_smooth(mSmooth);
 }
 
 bool texture::is_smooth() const noexcept
@@ -58,10 +76,12 @@ bool texture::is_smooth() const noexcept
 
 void texture::update_impl_image()
 {
-	if (!mImage.empty() && mImpl)
+	if (mImage && !mImage->empty() && mImpl)
 	{
-		mImpl->create_from_image(mImage);
+		mImpl->create_from_image(*mImage);
 		mImpl->set_smooth(mSmooth);
+		if (mResidency == image_residency::discard)
+			mImage.reset();
 	}
 }
 
@@ -0,0 +1,307 @@
+#include <wge/graphics/texture_atlas.hpp>
+#include <wge/graphics/graphics_backend.hpp>
+
+// Keep the symbols local so they don't collide with
+// other libraries that embed stb_rect_pack.
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <stb/stb_rect_pack.h>
+
+#include <algorithm>
+#include <tuple>
+
+namespace wge::graphics
+{
+
+struct texture_atlas::page
+{
+	stbrp_context context;
+	std::vector<stbrp_node> nodes;
+	image pixels;
+	texture page_texture;
+	bool dirty{ true };
+	// Images were removed so there is space to reclaim.
+	bool needs_repack{ false };
+
+	void reset(const math::ivec2& pSize)
+	{
+		nodes.resize(static_cast<std::size_t>(pSize.x));
+		stbrp_init_target(&context, pSize.x, pSize.y, nodes.data(), static_cast<int>(nodes.size()));
+	}
+
+	// Returns true if the rect was placed.
+	bool pack(const math::ivec2& pSize, int pPadding, math::ivec2& pResult)
+	{
+		stbrp_rect rect{};
+		rect.w = static_cast<stbrp_coord>(pSize.x + pPadding);
+		rect.h = static_cast<stbrp_coord>(pSize.y + pPadding);
+		stbrp_pack_rects(&context, &rect, 1);
+		if (!rect.was_packed)
+			return false;
+		pResult = { static_cast<int>(rect.x), static_cast<int>(rect.y) };
+		return true;
+	}
+};
+
+texture_atlas::texture_atlas() = default;
+
+texture_atlas::texture_atlas(const atlas_settings& pSettings) :
+	mSettings(pSettings)
+{}
+
+texture_atlas::~texture_atlas() = default;
+
+void texture_atlas::set_graphics_backend(const std::shared_ptr<graphics_backend>& pBackend)
+{
+	mBackend = pBackend;
+	for (auto& i : mPages)
+	{
+		i->page_texture.set_implementation(mBackend ? mBackend->create_immediate_texture_impl() : texture_impl::ptr{});
+		i->dirty = true;
+	}
+}
+
+void texture_atlas::set_settings(const atlas_settings& pSettings)
+{
+	mSettings = pSettings;
+	repack_all();
+}
+
+bool texture_atlas::insert(const void* pKey, const image& pImage, region_callback pOn_moved)
+{
+	if (pImage.empty())
+	{
+		remove(pKey);
+		return false;
+	}
+
+	auto iter = mEntries.find(pKey);
+	if (iter != mEntries.end())
+	{
+		if (iter->second.size == pImage.get_size())
+		{
+			// Same size so it can just be copied over the old one.
+			page& p = *mPages[iter->second.page];
+			p.pixels.splice(pImage, iter->second.position);
+			p.dirty = true;
+			iter->second.on_moved = std::move(pOn_moved);
+			notify(iter->second);
+			return true;
+		}
+		remove(pKey);
+	}
+
+	entry new_entry;
+	new_entry.size = pImage.get_size();
+	new_entry.on_moved = std::move(pOn_moved);
+	if (!allocate(new_entry))
+		return false;
+
+	page& p = *mPages[new_entry.page];
+	p.pixels.splice(pImage, new_entry.position);
+	p.dirty = true;
+
+	auto& result = mEntries[pKey] = std::move(new_entry);
+	notify(result);
+	return true;
+}
+
+void texture_atlas::remove(const void* pKey)
+{
+	auto iter = mEntries.find(pKey);
+	if (iter == mEntries.end())
+		return;
+	mPages[iter->second.page]->needs_repack = true;
+	mEntries.erase(iter);
+}
+
+bool texture_atlas::contains(const void* pKey) const noexcept
+{
+	return mEntries.find(pKey) != mEntries.end();
+}
+
+void texture_atlas::update_textures()
+{
+	repack_pending();
+	for (auto& i : mPages)
+	{
+		if (i->dirty)
+		{
+			i->page_texture.set_image(i->pixels);
+			i->dirty = false;
+		}
+	}
+}
+
+atlas_stats texture_atlas::get_stats() const noexcept
+{
+	atlas_stats stats;
+	stats.page_count = mPages.size();
+	stats.image_count = mEntries.size();
+	for (auto& i : mPages)
+		stats.cpu_bytes += i->pixels.get_raw().size();
+	if (!mPages.empty())
+	{
+		float used_area = 0;
+		for (auto& [key, i] : mEntries)
+			used_area += static_cast<float>(i.size.x) * static_cast<float>(i.size.y);
+		const float page_area = static_cast<float>(mSettings.page_size.x) * static_cast<float>(mSettings.page_size.y);
+		stats.occupancy = used_area / (page_area * static_cast<float>(mPages.size()));
+	}
+	return stats;
+}
+
+bool texture_atlas::allocate(entry& pEntry)
+{
+	if (pEntry.size.x + mSettings.padding > mSettings.page_size.x
+		|| pEntry.size.y + mSettings.padding > mSettings.page_size.y)
+		return false;
+
+	const auto pack_existing = [&]()
+	{
+		for (std::size_t i = 0; i < mPages.size(); i++)
+		{
+			if (mPages[i]->pack(pEntry.size, mSettings.padding, pEntry.position))
+			{
+				pEntry.page = i;
+				return true;
+			}
+		}
+		return false;
+	};
+
+	// Only reclaim removed space when there is no room left.
+	if (pack_existing() || (repack_pending() && pack_existing()))
+		return true;
+
+	pEntry.page = mPages.size();
+	return create_page().pack(pEntry.size, mSettings.padding, pEntry.position);
+}
+
+bool texture_atlas::repack_pending()
+{
+	std::vector<std::size_t> pending;
+	for (std::size_t i = 0; i < mPages.size(); i++)
+	{
+		if (mPages[i]->needs_repack)
+		{
+			// Cleared first so overflowing images can't trigger this again.
+			mPages[i]->needs_repack = false;
+			pending.push_back(i);
+		}
+	}
+	if (pending.empty())
+		return false;
+
+	// Group the entries by page in one pass.
+	std::vector<std::vector<std::pair<const void*, entry*>>> entries(mPages.size());
+	for (auto& [key, i] : mEntries)
+		entries[i.page].push_back({ key, &i });
+
+	std::vector<std::pair<const void*, image>> overflow;
+	for (std::size_t i : pending)
+		repack_page(i, entries[i], overflow);
+
+	// Only reinserted once every page is repacked so they can't land
+	// in a page that is about to be rebuilt.
+	for (auto& [key, pixels] : overflow)
+	{
+		auto callback = mEntries[key].on_moved;
+		mEntries.erase(key);
+		if (!insert(key, pixels, callback))
+			notify_dropped(callback, pixels);
+	}
+	return true;
+}
+
+void texture_atlas::repack_page(std::size_t pPage, std::vector<std::pair<const void*, entry*>>& pEntries,
+	std::vector<std::pair<const void*, image>>& pOverflow)
+{
+	page& p = *mPages[pPage];
+
+	// Pack the biggest first for a better fit.
+	std::sort(pEntries.begin(), pEntries.end(), [](const auto& pL, const auto& pR)
+	{
+		return pL.second->size.y > pR.second->size.y;
+	});
+
+	const image old_pixels = std::move(p.pixels);
+	p.pixels = image(mSettings.page_size);
+	p.reset(mSettings.page_size);
+	p.dirty = true;
+
+	for (auto& [key, i] : pEntries)
+	{
+		const math::ivec2 old_position = i->position;
+		if (p.pack(i->size, mSettings.padding, i->position))
+		{
+			p.pixels.splice(old_pixels, i->position, old_position, old_position + i->size - math::ivec2{ 1, 1 });
+			notify(*i);
+		}
+		else
+		{
+			// Packing order changed and it doesn't fit anymore. Move it to another page.
+			pOverflow.push_back({ key, old_pixels.crop(old_position, old_position + i->size - math::ivec2{ 1, 1 }) });
+		}
+	}
+}
+
+void texture_atlas::repack_all()
+{
+	// Collect all the images before throwing the pages away.
+	std::vector<std::tuple<const void*, image, region_callback>> images;
+	for (auto& [key, i] : mEntries)
+	{
+		const image& pixels = mPages[i.page]->pixels;
+		images.emplace_back(key, pixels.crop(i.position, i.position + i.size - math::ivec2{ 1, 1 }), i.on_moved);
+	}
+	mEntries.clear();
+	mPages.clear();
+
+	// Biggest first for a better fit.
+	std::sort(images.begin(), images.end(), [](const auto& pL, const auto& pR)
+	{
+		return std::get<1>(pL).get_height() > std::get<1>(pR).get_height();
+	});
+	for (auto& [key, pixels, callback] : images)
+		if (!insert(key, pixels, callback))
+			notify_dropped(callback, pixels);
+}
+
+void texture_atlas::notify(const entry& pEntry) const
+{
+	if (!pEntry.on_moved)
+		return;
+	const math::vec2 page_size{ mSettings.page_size };
+	atlas_region region;
+	region.page_texture = &mPages[pEntry.page]->page_texture;
+	region.uv.min = math::vec2{ pEntry.position } / page_size;
+	region.uv.max = math::vec2{ pEntry.position + pEntry.size } / page_size;
+	pEntry.on_moved(region);
+}
+
+void texture_atlas::notify_dropped(const region_callback& pCallback, const image& pPixels)
+{
+	if (!pCallback)
+		return;
+	atlas_region region;
+	region.dropped_pixels = &pPixels;
+	pCallback(region);
+}
+
+texture_atlas::page& texture_atlas::create_page()
+{
+	auto new_page = std::make_unique<page>();
+	new_page->pixels = image(mSettings.page_size);
+	new_page->reset(mSettings.page_size);
+	// The page keeps its pixels for repacking so the texture doesn't need them too.
+	new_page->page_texture.set_residency(image_residency::discard);
+	// Pages skip the upload queue. Sprites use the new uvs in the same
+	// frame so the pixels have to be there too.
+	if (mBackend)
+		new_page->page_texture.set_implementation(mBackend->create_immediate_texture_impl());
+	mPages.push_back(std::move(new_page));
+	return *mPages.back();
+}
+
+} // namespace wge::graphics
@@ -82,6 +82,19 @@ transform& transform::operator *= (const transform& pTransform) noexcept
 	return *this = apply_to(pTransform);
 }
 
+bool transform::operator == (const transform& pTransform) const noexcept
+{
+	return position == pTransform.position
+		&& rotation == pTransform.rotation
+		&& scale == pTransform.scale
+		&& shear == pTransform.shear;
+}
+
+bool transform::operator != (const transform& pTransform) const noexcept
+{
+	return !(*this == pTransform);
+}
+
 transform::operator math::mat33() const noexcept
 {
 	return get_matrix();
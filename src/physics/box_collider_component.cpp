@@ -12,7 +12,8 @@ namespace wge::physics
 box_collider_component::box_collider_component() :
 	mFixture(nullptr),
 	mSize(1, 1),
-	mIs_sensor(false)
+	mIs_sensor(false),
+	mShape_dirty(true)
 {
 }
 
@@ -23,6 +24,7 @@ box_collider_component::~box_collider_component()
 void box_collider_component::set_offset(const math::vec2 & pOffset)
 {
 	mOffset = pOffset;
+	mShape_dirty = true;
 }
 
 math::vec2 box_collider_component::get_offset() const
@@ -35,6 +37,7 @@ void box_collider_component::set_size(const math::vec2 & pSize)
 	if (pSize.x > 0 && pSize.y > 0)
 	{
 		mSize = pSize;
+		mShape_dirty = true;
 	}
 }
 
@@ -46,6 +49,7 @@ math::vec2 box_collider_component::get_size() const
 void box_collider_component::set_rotation(math::radians pRads)
 {
 	mRotation = pRads;
+	mShape_dirty = true;
 }
 
 math::radians box_collider_component::get_rotation() const
@@ -68,6 +72,7 @@ bool box_collider_component::is_sensor() const
 void box_collider_component::set_anchor(math::vec2 pRatio)
 {
 	mAnchor = pRatio;
+	mShape_dirty = true;
 }
 
 math::vec2 box_collider_component::get_anchor() const
@@ -91,13 +96,20 @@ void box_collider_component::update_shape(const math::vec2& pScale, b2PolygonSha
 	}
 }
 
-void box_collider_component::update_current_shape(const math::vec2& pScale)
+bool box_collider_component::update_current_shape(const math::vec2& pScale)
 {
-	if (mFixture)
-	{
-		update_shape(pScale, dynamic_cast<b2PolygonShape*>(mFixture->GetShape()));
-		mFixture->GetBody()->ResetMassData();
-	}
+	if (!mFixture)
+		return false;
+
+	const math::ivec2 scale = quantize_fixture_scale(pScale);
+	if (!mShape_dirty && scale == mShape_scale)
+		return false;
+
+	update_shape(pScale, dynamic_cast<b2PolygonShape*>(mFixture->GetShape()));
+	mFixture->GetBody()->ResetMassData();
+	mShape_scale = scale;
+	mShape_dirty = false;
+	return true;
 }
 
 } // namespace wge::physics
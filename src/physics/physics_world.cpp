@@ -1,19 +1,68 @@
 #include <wge/physics/physics_world.hpp>
 #include <wge/physics/physics_component.hpp>
 #include <wge/physics/box_collider_component.hpp>
+#include <wge/physics/tilemap_collider.hpp>
 #include <wge/math/transform.hpp>
 #include <wge/graphics/sprite_component.hpp>
 
 #include <wge/core/layer.hpp>
+#include <wge/core/scene.hpp>
+#include <wge/logging/log.hpp>
 
 #include <Box2D/Box2D.h>
 
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
 namespace wge::physics
 {
 
 physics_world::physics_world() :
 	mWorld(std::make_unique<b2World>(b2Vec2(0, 1)))
-{}
+{
+	mContact_listener = std::make_unique<contact_listener>(mContacts);
+	mWorld->SetContactListener(mContact_listener.get());
+}
+
+static core::object_id get_fixture_object(const b2Fixture* pFixture) noexcept
+{
+	return static_cast<core::object_id>(reinterpret_cast<std::uintptr_t>(pFixture->GetUserData()));
+}
+
+// Shapes touching each other can produce more than one contact
+// so every object is only listed once.
+static void add_contact(contact_buffer::contact_map& pMap, core::object_id pObject, core::object_id pOther)
+{
+	if (pObject == core::invalid_id)
+		return;
+	auto& others = pMap[pObject];
+	if (std::find(others.begin(), others.end(), pOther) == others.end())
+		others.push_back(pOther);
+}
+
+static void record_contact(contact_buffer::contact_map& pMap, const b2Contact* pContact)
+{
+	const core::object_id a = get_fixture_object(pContact->GetFixtureA());
+	const core::object_id b = get_fixture_object(pContact->GetFixtureB());
+	if (a == b)
+		return;
+	add_contact(pMap, a, b);
+	add_contact(pMap, b, a);
+}
+
+void physics_world::contact_listener::BeginContact(b2Contact* pContact)
+{
+	record_contact(mBuffer->begin, pContact);
+}
+
+void physics_world::contact_listener::EndContact(b2Contact* pContact)
+{
+	record_contact(mBuffer->end, pContact);
+}
 
 void physics_world::set_gravity(math::vec2 pVec)
 {
@@ -31,8 +80,373 @@ b2World* physics_world::get_world() const
 	return mWorld.get();
 }
 
-void physics_world::preupdate(core::layer& pLayer, float pSq_pixel_size, float pDelta)
+// Queries are handed out to the workers in groups this large
+// so they don't fight over the next index.
+constexpr std::size_t query_group_size = 64;
+
+template <typename Tcallback>
+void physics_world::for_each_query(std::size_t pCount, Tcallback&& pCallback) const
+{
+	// Small batches are faster without the threads.
+	if (pCount <= query_group_size)
+	{
+		for (std::size_t i = 0; i < pCount; i++)
+			pCallback(i);
+		return;
+	}
+
+	if (!mWorkers)
+		mWorkers = std::make_unique<util::thread_pool>();
+
+	// Queries only read the broadphase so they can all run at once.
+	const std::size_t group_count = (pCount + query_group_size - 1) / query_group_size;
+	mWorkers->parallel_for(group_count, [&](std::size_t pGroup)
+	{
+		const std::size_t end = std::min(pCount, (pGroup + 1) * query_group_size);
+		for (std::size_t i = pGroup * query_group_size; i < end; i++)
+			pCallback(i);
+	});
+}
+
+void physics_world::raycast_closest(util::span<const ray> pRays, util::span<raycast_hit_info> pResults) const
+{
+	assert(pResults.size() >= pRays.size());
+	for_each_query(pRays.size(), [&](std::size_t pIndex)
+	{
+		pResults[pIndex] = find_closest_hit(pRays[pIndex].from, pRays[pIndex].to);
+	});
+}
+
+std::vector<raycast_hit_info> physics_world::raycast_closest(util::span<const ray> pRays) const
+{
+	std::vector<raycast_hit_info> results(pRays.size());
+	raycast_closest(pRays, results);
+	return results;
+}
+
+void physics_world::test_aabb(util::span<const math::aabb> pAabbs, util::span<bool> pResults) const
+{
+	assert(pResults.size() >= pAabbs.size());
+	for_each_query(pAabbs.size(), [&](std::size_t pIndex)
+	{
+		pResults[pIndex] = test_aabb(pAabbs[pIndex]);
+	});
+}
+
+struct tilemap_collision_chunk
+{
+	std::uint64_t version{ 0 };
+	std::vector<b2Fixture*> fixtures;
+};
+
+// Layer component holding the fixtures of all chunks in a tilemap layer.
+struct tilemap_collision_cache
+{
+	b2Body* body{ nullptr };
+	std::unordered_map<std::uint64_t, tilemap_collision_chunk> chunks;
+};
+
+void physics_world::update_tilemap_collision(core::layer& pLayer)
+{
+	const tilemap_collider* collider = pLayer.layer_components.get<tilemap_collider>();
+	const core::tile_grid* grid = pLayer.layer_components.get<core::tile_grid>();
+	auto cache = pLayer.layer_components.get<tilemap_collision_cache>();
+	if (!collider || !grid)
+	{
+		// The collider was removed.
+		if (cache)
+		{
+			if (cache->body)
+				mWorld->DestroyBody(cache->body);
+			pLayer.layer_components.remove<tilemap_collision_cache>();
+		}
+		return;
+	}
+
+	if (!cache)
+		cache = pLayer.layer_components.insert(tilemap_collision_cache{});
+
+	// All the tiles in a layer share one static body.
+	if (!cache->body)
+	{
+		b2BodyDef body_def;
+		body_def.type = b2_staticBody;
+		body_def.userData = reinterpret_cast<void*>(static_cast<std::uintptr_t>(core::invalid_id));
+		cache->body = mWorld->CreateBody(&body_def);
+	}
+
+	const auto destroy_fixtures = [&](tilemap_collision_chunk& pChunk)
+	{
+		for (b2Fixture* i : pChunk.fixtures)
+			cache->body->DestroyFixture(i);
+		pChunk.fixtures.clear();
+	};
+
+	// Drop the chunks that no longer have any tiles.
+	for (auto iter = cache->chunks.begin(); iter != cache->chunks.end();)
+	{
+		if (grid->get_chunks().count(iter->first) == 0)
+		{
+			destroy_fixtures(iter->second);
+			iter = cache->chunks.erase(iter);
+		}
+		else
+			++iter;
+	}
+
+	// Only chunks that have been modified are rebuilt.
+	for (const auto& [key, source] : grid->get_chunks())
+	{
+		tilemap_collision_chunk& chunk = cache->chunks[key];
+		if (chunk.version == source.version)
+			continue;
+
+		destroy_fixtures(chunk);
+		for (const tile_rect& rect : merge_tile_rects(source))
+		{
+			const math::vec2 hsize = math::vec2(rect.size) / 2.f;
+			const math::vec2 center = math::vec2(rect.position) + hsize;
+			b2PolygonShape shape;
+			shape.SetAsBox(hsize.x, hsize.y, { center.x, center.y }, 0);
+
+			b2FixtureDef fixture_def;
+			fixture_def.shape = &shape;
+			fixture_def.friction = collider->friction;
+			fixture_def.userData = reinterpret_cast<void*>(static_cast<std::uintptr_t>(core::invalid_id));
+			chunk.fixtures.push_back(cache->body->CreateFixture(&fixture_def));
+		}
+		chunk.version = source.version;
+	}
+}
+
+physics_snapshot physics_world::snapshot() const
 {
+	physics_snapshot result;
+	result.bodies.reserve(static_cast<std::size_t>(mWorld->GetBodyCount()));
+	for (const b2Body* body = mWorld->GetBodyList(); body; body = body->GetNext())
+	{
+		const core::object_id id = static_cast<core::object_id>(reinterpret_cast<std::uintptr_t>(body->GetUserData()));
+		if (id == core::invalid_id)
+			continue;
+
+		physics_snapshot::body_record& record = result.bodies.emplace_back();
+		record.object_id = id;
+		record.type = body->GetType();
+		record.position = body->GetPosition();
+		record.angle = body->GetAngle();
+		record.linear_velocity = body->GetLinearVelocity();
+		record.angular_velocity = body->GetAngularVelocity();
+		record.linear_damping = body->GetLinearDamping();
+		record.angular_damping = body->GetAngularDamping();
+		record.gravity_scale = body->GetGravityScale();
+		record.awake = body->IsAwake();
+		record.active = body->IsActive();
+		record.sleeping_allowed = body->IsSleepingAllowed();
+		record.fixed_rotation = body->IsFixedRotation();
+		record.bullet = body->IsBullet();
+		record.first_fixture = static_cast<std::uint32_t>(result.fixtures.size());
+
+		for (const b2Fixture* fixture = body->GetFixtureList(); fixture; fixture = fixture->GetNext())
+		{
+			const b2Shape* shape = fixture->GetShape();
+			if (shape->GetType() != b2Shape::e_polygon && shape->GetType() != b2Shape::e_circle)
+				continue;
+
+			physics_snapshot::fixture_record& fixture_record = result.fixtures.emplace_back();
+			fixture_record.object_id = get_fixture_object(fixture);
+			fixture_record.shape_type = shape->GetType();
+			fixture_record.radius = shape->m_radius;
+			if (fixture_record.shape_type == b2Shape::e_polygon)
+			{
+				// The shape is copied exactly instead of being recomputed from the vertices.
+				const auto* polygon = static_cast<const b2PolygonShape*>(shape);
+				fixture_record.center = polygon->m_centroid;
+				fixture_record.vertex_count = polygon->m_count;
+				std::copy_n(polygon->m_vertices, polygon->m_count, fixture_record.vertices);
+				std::copy_n(polygon->m_normals, polygon->m_count, fixture_record.normals);
+			}
+			else
+			{
+				fixture_record.center = static_cast<const b2CircleShape*>(shape)->m_p;
+			}
+			fixture_record.friction = fixture->GetFriction();
+			fixture_record.restitution = fixture->GetRestitution();
+			fixture_record.density = fixture->GetDensity();
+			fixture_record.is_sensor = fixture->IsSensor();
+			fixture_record.filter = fixture->GetFilterData();
+			++record.fixture_count;
+		}
+	}
+	return result;
+}
+
+void physics_world::restore(const physics_snapshot& pSnapshot, core::scene& pScene)
+{
+	// A new world so nothing is left over from the old one.
+	const b2Vec2 gravity = mWorld->GetGravity();
+	mWorld = std::make_unique<b2World>(gravity);
+	mWorld->SetContactListener(mContact_listener.get());
+	mContacts.clear();
+
+	// Box2D puts new bodies and fixtures at the front of its lists so
+	// they are created backwards to end up in the same order as before.
+	for (auto body_iter = pSnapshot.bodies.rbegin(); body_iter != pSnapshot.bodies.rend(); ++body_iter)
+	{
+		const physics_snapshot::body_record& record = *body_iter;
+		b2BodyDef body_def;
+		body_def.type = record.type;
+		body_def.position = record.position;
+		body_def.angle = record.angle;
+		body_def.linearVelocity = record.linear_velocity;
+		body_def.angularVelocity = record.angular_velocity;
+		body_def.linearDamping = record.linear_damping;
+		body_def.angularDamping = record.angular_damping;
+		body_def.gravityScale = record.gravity_scale;
+		body_def.awake = record.awake;
+		body_def.active = record.active;
+		body_def.allowSleep = record.sleeping_allowed;
+		body_def.fixedRotation = record.fixed_rotation;
+		body_def.bullet = record.bullet;
+		body_def.userData = reinterpret_cast<void*>(static_cast<std::uintptr_t>(record.object_id));
+		b2Body* body = mWorld->CreateBody(&body_def);
+
+		for (std::uint32_t i = record.fixture_count; i > 0; i--)
+		{
+			const physics_snapshot::fixture_record& fixture_record = pSnapshot.fixtures[record.first_fixture + i - 1];
+			b2PolygonShape polygon;
+			b2CircleShape circle;
+			b2FixtureDef fixture_def;
+			if (fixture_record.shape_type == b2Shape::e_polygon)
+			{
+				polygon.m_radius = fixture_record.radius;
+				polygon.m_centroid = fixture_record.center;
+				polygon.m_count = fixture_record.vertex_count;
+				std::copy_n(fixture_record.vertices, fixture_record.vertex_count, polygon.m_vertices);
+				std::copy_n(fixture_record.normals, fixture_record.vertex_count, polygon.m_normals);
+				fixture_def.shape = &polygon;
+			}
+			else
+			{
+				circle.m_radius = fixture_record.radius;
+				circle.m_p = fixture_record.center;
+				fixture_def.shape = &circle;
+			}
+			fixture_def.friction = fixture_record.friction;
+			fixture_def.restitution = fixture_record.restitution;
+			fixture_def.density = fixture_record.density;
+			fixture_def.isSensor = fixture_record.is_sensor;
+			fixture_def.filter = fixture_record.filter;
+			fixture_def.userData = reinterpret_cast<void*>(static_cast<std::uintptr_t>(fixture_record.object_id));
+			body->CreateFixture(&fixture_def);
+		}
+	}
+
+	mInactive_bodies = 0;
+	for (const b2Body* body = mWorld->GetBodyList(); body; body = body->GetNext())
+		if (!body->IsActive())
+			++mInactive_bodies;
+
+	// Every layer has to be relinked. Anything left pointing at the old world would dangle.
+	for (auto& i : pScene)
+		if (is_layer_world(i))
+			relink(i);
+}
+
+scene_physics_snapshot physics_world::checkpoint(core::scene& pScene)
+{
+	scene_physics_snapshot result;
+	result.world = snapshot();
+	for (auto& i : pScene)
+	{
+		const isolated_physics* isolated = i.layer_components.get<isolated_physics>();
+		if (isolated && isolated->world)
+			result.layers.push_back(isolated->world->snapshot());
+		else
+			result.layers.emplace_back();
+	}
+
+	// Warm starting and contacts aren't saved so the live
+	// run has to start over from the same state.
+	restore(result, pScene);
+	return result;
+}
+
+void physics_world::restore(const scene_physics_snapshot& pSnapshot, core::scene& pScene)
+{
+	restore(pSnapshot.world, pScene);
+	std::size_t index = 0;
+	for (auto& i : pScene)
+	{
+		if (index >= pSnapshot.layers.size())
+			break;
+		if (const auto& layer_snapshot = pSnapshot.layers[index++])
+		{
+			physics_world& world = get_layer_world(i);
+			if (&world != this)
+				world.restore(*layer_snapshot, pScene);
+		}
+	}
+}
+
+bool physics_world::is_layer_world(const core::layer& pLayer) const noexcept
+{
+	const isolated_physics* isolated = pLayer.layer_components.get<isolated_physics>();
+	if (isolated && isolated->world)
+		return isolated->world.get() == this;
+	// Layers without a world of their own use the main one.
+	return !mIs_isolated && !isolated;
+}
+
+void physics_world::relink(core::layer& pLayer)
+{
+	std::unordered_map<core::object_id, b2Body*> bodies;
+	for (b2Body* body = mWorld->GetBodyList(); body; body = body->GetNext())
+		bodies[static_cast<core::object_id>(reinterpret_cast<std::uintptr_t>(body->GetUserData()))] = body;
+
+	// Objects that weren't in the snapshot get new bodies in the next preupdate.
+	for (auto [id, physics, transform] : pLayer.each<physics_component, math::transform>())
+	{
+		auto iter = bodies.find(id);
+		physics.mBody = iter == bodies.end() ? nullptr : iter->second;
+		physics.mHas_state = false;
+		physics.mIs_interpolated = false;
+		if (physics.mBody)
+		{
+			const b2Vec2& position = physics.mBody->GetPosition();
+			transform.position = math::vec2{ position.x, position.y };
+			transform.rotation = math::radians(physics.mBody->GetAngle());
+			physics.mSynced = { transform.position, transform.rotation };
+			physics.mPrevious = physics.mCurrent = physics.mSynced;
+			physics.mHas_state = true;
+		}
+	}
+
+	// Objects only get a sprite fixture from the physics world.
+	for (auto [id, fixture, physics] : pLayer.each<sprite_fixture, physics_component>())
+		fixture.mFixture = physics.mBody ? physics.mBody->GetFixtureList() : nullptr;
+
+	for (auto [id, collider] : pLayer.each<box_collider_component>())
+		collider.mFixture = nullptr;
+
+	// The tiles are rebuilt by the next preupdate.
+	pLayer.layer_components.remove<tilemap_collision_cache>();
+}
+
+void physics_world::preupdate(core::layer& pLayer, float pSq_pixel_size)
+{
+	// Undo interpolation unless something else moved the object since.
+	for (auto [id, physics, transform] : pLayer.each<physics_component, math::transform>())
+	{
+		if (physics.mIs_interpolated
+			&& transform.position == physics.mRendered.position
+			&& transform.rotation == physics.mRendered.rotation)
+		{
+			transform.position = physics.mCurrent.position;
+			transform.rotation = physics.mCurrent.rotation;
+		}
+		physics.mIs_interpolated = false;
+	}
+
 	// Create all the bodies
 	for (auto [id, physics, transform] : pLayer.each<physics_component, math::transform>())
 	{
@@ -46,6 +460,7 @@ void physics_world::preupdate(core::layer& pLayer, float pSq_pixel_size, float p
 			body_def.userData = reinterpret_cast<void*>(static_cast<std::uintptr_t>(id));
 			physics.mBody = mWorld->CreateBody(&body_def);
 			physics.mBody->ResetMassData();
+			physics.mSynced = { transform.position, transform.rotation };
 		}
 	}
 
@@ -53,58 +468,253 @@ void physics_world::preupdate(core::layer& pLayer, float pSq_pixel_size, float p
 	for (auto [id, sprite_col_comp, physics_comp, sprite_comp, transform_comp] :
 		pLayer.each<sprite_fixture, physics_component, graphics::sprite_component, math::transform>())
 	{
-		if ((!sprite_col_comp.mFixture || sprite_col_comp.mLast_scale != transform_comp.scale)
-			&& physics_comp.mBody && sprite_comp.get_sprite())
-		{
-			// Create the shape around the sprite.
-			const auto sprite = sprite_comp.get_sprite()->get_resource<graphics::sprite>();
-			const math::vec2 box_offset = ((sprite->get_aabb_collision().min * transform_comp.scale) / pSq_pixel_size);
-			const math::vec2 box_size = (sprite->get_aabb_collision().max - sprite->get_aabb_collision().min).abs() * transform_comp.scale / pSq_pixel_size;
-			const math::vec2 box_hsize = box_size / 2.f;
-			const math::vec2 frame_anchor = (math::vec2(sprite->get_frame_anchor(sprite_comp.get_controller().get_frame())) * transform_comp.scale) / pSq_pixel_size;
-			const math::vec2 center = box_hsize - frame_anchor + box_offset;
-			b2PolygonShape shape;
-			shape.SetAsBox(box_hsize.x, box_hsize.y, { center.x, center.y }, 0);
+		if (!physics_comp.mBody || !sprite_comp.get_sprite())
+			continue;
 
-			// Setup the fixture settings.
-			b2FixtureDef fixture_def;
-			fixture_def.shape = &shape;
-			fixture_def.density = 1;
-			fixture_def.userData = reinterpret_cast<void*>(static_cast<std::uintptr_t>(id));
-			
-			// Remove the existing fixture
-			if (sprite_col_comp.mFixture)
-				physics_comp.mBody->DestroyFixture(sprite_col_comp.mFixture);
-
-			// Create the new fixture.
-			sprite_col_comp.mFixture = physics_comp.mBody->CreateFixture(&fixture_def);
-			sprite_col_comp.mLast_scale = transform_comp.scale;
+		const auto sprite = sprite_comp.get_sprite()->get_resource<graphics::sprite>();
+		const sprite_fixture_key key{
+			sprite->get_aabb_collision(),
+			sprite->get_frame_anchor(sprite_comp.get_controller().get_frame()),
+			quantize_fixture_scale(transform_comp.scale) };
+
+		// Reuse the fixture until the shape actually changes.
+		if (sprite_col_comp.mFixture && sprite_col_comp.mKey == key)
+			continue;
+
+		// Create the shape around the sprite.
+		const math::vec2 box_offset = ((key.collision.min * transform_comp.scale) / pSq_pixel_size);
+		const math::vec2 box_size = (key.collision.max - key.collision.min).abs() * transform_comp.scale / pSq_pixel_size;
+		const math::vec2 box_hsize = box_size / 2.f;
+		const math::vec2 frame_anchor = (key.anchor * transform_comp.scale) / pSq_pixel_size;
+		const math::vec2 center = box_hsize - frame_anchor + box_offset;
+		b2PolygonShape shape;
+		shape.SetAsBox(box_hsize.x, box_hsize.y, { center.x, center.y }, 0);
+
+		// Setup the fixture settings.
+		b2FixtureDef fixture_def;
+		fixture_def.shape = &shape;
+		fixture_def.density = 1;
+		fixture_def.userData = reinterpret_cast<void*>(static_cast<std::uintptr_t>(id));
+		
+		// Remove the existing fixture
+		if (sprite_col_comp.mFixture)
+			physics_comp.mBody->DestroyFixture(sprite_col_comp.mFixture);
+
+		// Create the new fixture.
+		sprite_col_comp.mFixture = physics_comp.mBody->CreateFixture(&fixture_def);
+		sprite_col_comp.mKey = key;
+		++mFixture_rebuilds;
+	}
+
+	update_tilemap_collision(pLayer);
+}
+
+void physics_world::update_activity()
+{
+	if (mActivity_regions.empty() && mInactive_bodies == 0)
+		return;
+
+	const auto is_inside = [&](const b2Vec2& pPosition, float pMargin)
+	{
+		for (const auto& i : mActivity_regions)
+			if (pPosition.x >= i.min.x - pMargin && pPosition.x <= i.max.x + pMargin
+				&& pPosition.y >= i.min.y - pMargin && pPosition.y <= i.max.y + pMargin)
+				return true;
+		return mActivity_regions.empty();
+	};
+
+	mInactive_bodies = 0;
+	for (b2Body* body = mWorld->GetBodyList(); body; body = body->GetNext())
+	{
+		// Static bodies cost nothing to step.
+		if (body->GetType() == b2_staticBody)
+			continue;
+
+		const b2Vec2& position = body->GetPosition();
+		if (body->IsActive())
+		{
+			if (!is_inside(position, mActivity_margin))
+			{
+				body->SetActive(false);
+				++mInactive_bodies;
+			}
 		}
+		else if (is_inside(position, 0))
+			body->SetActive(true);
+		else
+			++mInactive_bodies;
 	}
+}
+
+void physics_world::step(float pDelta)
+{
+	update_activity();
 
-	// Calculate physics
-	mWorld->Step(pDelta, 1, 1);
-	update_object_transforms(pLayer);
+	const int substeps = std::max(mStep_settings.substeps, 1);
+	const float substep_delta = pDelta / static_cast<float>(substeps);
+	b2Profile profile{};
+	for (int i = 0; i < substeps; i++)
+	{
+		mWorld->Step(substep_delta, mStep_settings.velocity_iterations, mStep_settings.position_iterations);
+		const b2Profile& last = mWorld->GetProfile();
+		profile.step += last.step;
+		profile.collide += last.collide;
+		profile.solve += last.solve;
+		profile.broadphase += last.broadphase;
+		profile.solveTOI += last.solveTOI;
+	}
+	update_stats(profile);
 }
 
-void physics_world::postupdate(core::layer& pLayer, float pDelta)
+const char* physics_stats::get_csv_header() noexcept
+{
+	return "step_ms,collide_ms,solve_ms,broadphase_ms,solve_toi_ms,"
+		"bodies,inactive_bodies,fixtures,contacts,proxies,tree_height,fixture_rebuilds";
+}
+
+std::string physics_stats::to_csv() const
+{
+	return fmt::format("{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},{},{},{},{},{},{},{}",
+		step, collide, solve, broadphase, solve_toi,
+		bodies, inactive_bodies, fixtures, contacts, proxies, tree_height, fixture_rebuilds);
+}
+
+void physics_world::update_stats(const b2Profile& pProfile)
+{
+	mStats.step = pProfile.step;
+	mStats.collide = pProfile.collide;
+	mStats.solve = pProfile.solve;
+	mStats.broadphase = pProfile.broadphase;
+	mStats.solve_toi = pProfile.solveTOI;
+
+	mStats.bodies = static_cast<std::size_t>(mWorld->GetBodyCount());
+	mStats.inactive_bodies = mInactive_bodies;
+	mStats.contacts = static_cast<std::size_t>(mWorld->GetContactCount());
+	mStats.proxies = static_cast<std::size_t>(mWorld->GetProxyCount());
+	mStats.tree_height = mWorld->GetTreeHeight();
+	mStats.fixture_rebuilds = mFixture_rebuilds - mLast_fixture_rebuilds;
+	mLast_fixture_rebuilds = mFixture_rebuilds;
+	mStats_fixtures_counted = false;
+
+	if (!mStats_log.is_open())
+		return;
+
+	mStats.fixtures = count_fixtures();
+	mStats_fixtures_counted = true;
+
+	// Roll over so long runs don't fill up the disk.
+	if (mStats_log_rows >= mStats_log_max_rows)
+	{
+		mStats_log.close();
+		const std::string old_path = mStats_log_path + ".old";
+		std::remove(old_path.c_str());
+		std::rename(mStats_log_path.c_str(), old_path.c_str());
+		mStats_log.open(mStats_log_path, std::ios::trunc);
+		mStats_log << physics_stats::get_csv_header() << '\n';
+		mStats_log_rows = 0;
+	}
+	mStats_log << mStats.to_csv() << '\n';
+	++mStats_log_rows;
+}
+
+const physics_stats& physics_world::get_stats() const noexcept
+{
+	if (!mStats_fixtures_counted)
+	{
+		mStats.fixtures = count_fixtures();
+		mStats_fixtures_counted = true;
+	}
+	return mStats;
+}
+
+std::size_t physics_world::count_fixtures() const noexcept
+{
+	std::size_t count = 0;
+	for (const b2Body* body = mWorld->GetBodyList(); body; body = body->GetNext())
+		for (const b2Fixture* fixture = body->GetFixtureList(); fixture; fixture = fixture->GetNext())
+			++count;
+	return count;
+}
+
+void physics_world::set_stats_log(const std::string& pPath, std::size_t pMax_rows)
+{
+	mStats_log.close();
+	mStats_log_path = pPath;
+	mStats_log_max_rows = std::max<std::size_t>(pMax_rows, 1);
+	mStats_log_rows = 0;
+	if (pPath.empty())
+		return;
+	mStats_log.open(pPath, std::ios::trunc);
+	if (!mStats_log)
+	{
+		log::error("Could not open \"{}\" for logging physics stats.", pPath);
+		return;
+	}
+	mStats_log << physics_stats::get_csv_header() << '\n';
+}
+
+void physics_world::step(float pDelta, util::span<physics_world* const> pOthers)
+{
+	if (pOthers.empty())
+	{
+		step(pDelta);
+		return;
+	}
+
+	if (!mWorkers)
+		mWorkers = std::make_unique<util::thread_pool>();
+
+	// This world is index 0.
+	mWorkers->parallel_for(pOthers.size() + 1, [&](std::size_t pIndex)
+	{
+		physics_world& world = pIndex == 0 ? *this : *pOthers[pIndex - 1];
+		world.step(pDelta);
+	});
+}
+
+physics_world& physics_world::get_layer_world(core::layer& pLayer)
+{
+	isolated_physics* isolated = pLayer.layer_components.get<isolated_physics>();
+	if (!isolated)
+		return *this;
+	if (!isolated->world)
+	{
+		isolated->world = std::make_shared<physics_world>();
+		isolated->world->mIs_isolated = true;
+		isolated->world->set_gravity(get_gravity());
+		isolated->world->set_step_settings(mStep_settings);
+	}
+	return *isolated->world;
+}
+
+void physics_world::postupdate(core::layer& pLayer)
 {
-	// Update the body to the transform of the transform component
 	for (auto [id, physics, transform] : pLayer.each<physics_component, math::transform>())
 	{
 		if (physics.mBody)
 		{
-			math::vec2 position = transform.position;
-			math::radians rotation = transform.rotation;
-			physics.mBody->SetTransform({ position.x, position.y }, rotation);
+			const physics_component::body_state state{ transform.position, transform.rotation };
+
+			// Only bodies that were moved by gameplay are touched. Setting
+			// the transform of a body wakes it up and refreshes its contacts.
+			if (state != physics.mSynced)
+			{
+				physics.mBody->SetTransform({ state.position.x, state.position.y }, state.rotation);
+				physics.mSynced = state;
+			}
+
+			// Bodies start out without anything to interpolate from.
+			physics.mPrevious = physics.mHas_state ? physics.mCurrent : state;
+			physics.mCurrent = state;
+			physics.mHas_state = true;
 		}
 	}
 
 	// Update the shapes
 	for (auto [id, collider, transform] : pLayer.each<box_collider_component, math::transform>())
 	{
-		// FIXME: Only update when the transform's scale actually changes.
-		collider.update_current_shape(transform.scale);
+		if (collider.update_current_shape(transform.scale))
+			++mFixture_rebuilds;
 	}
 }
 
@@ -112,13 +722,33 @@ void physics_world::update_object_transforms(core::layer& pLayer)
 {
 	for (auto [id, physics, transform] : pLayer.each<physics_component, math::transform>())
 	{
-		if (physics.mBody)
+		// Sleeping and static bodies haven't moved since they were last synced.
+		if (physics.mBody && physics.mBody->IsAwake() && physics.mBody->GetType() != b2_staticBody)
 		{
 			b2Vec2 position = physics.mBody->GetPosition();
 			transform.position = math::vec2{ position.x, position.y };
 			transform.rotation = math::radians(physics.mBody->GetAngle());
+			physics.mSynced = { transform.position, transform.rotation };
 		}
 	}
 }
 
+void physics_world::interpolate(core::layer& pLayer, float pAlpha)
+{
+	for (auto [id, physics, transform] : pLayer.each<physics_component, math::transform>())
+	{
+		const auto& previous = physics.mPrevious;
+		const auto& current = physics.mCurrent;
+		// Nothing to do for objects that are resting.
+		if (!physics.mHas_state || previous == current)
+			continue;
+		physics.mRendered.position = previous.position + (current.position - previous.position) * pAlpha;
+		physics.mRendered.rotation = math::radians(previous.rotation.value()
+			+ (current.rotation.value() - previous.rotation.value()) * pAlpha);
+		transform.position = physics.mRendered.position;
+		transform.rotation = physics.mRendered.rotation;
+		physics.mIs_interpolated = true;
+	}
+}
+
 } // namespacw wge::physics
\ No newline at end of file
@@ -5,7 +5,9 @@
 #include <wge/math/transform.hpp>
 #include <wge/math/rect.hpp>
 
+#include <memory>
 #include <regex>
+#include <vector>
 
 namespace wge::scripting
 {
@@ -430,9 +432,11 @@ public:
 
 void script_engine::register_physics_api(physics::physics_world& pPhysics, core::scene& pScene)
 {
-	state["physics_raycast"] = [&pPhysics, &pScene](sol::table pResult, const math::vec2& pA, const math::vec2& pB) -> bool
+	mPhysics = &pPhysics;
+
+	state["physics_raycast"] = [this, &pScene](sol::table pResult, const math::vec2& pA, const math::vec2& pB) -> bool
 	{
-		const physics::raycast_hit_info hit = pPhysics.raycast_closest(pA, pB);
+		const physics::raycast_hit_info hit = get_physics().raycast_closest(pA, pB);
 		if (hit.hit && pResult.valid())
 		{
 			pResult["normal"] = hit.normal;
@@ -443,11 +447,11 @@ void script_engine::register_physics_api(physics::physics_world& pPhysics, core:
 		return hit.hit;
 	};
 
-	state["physics_raycast_each"] = [this, &pPhysics, &pScene](sol::safe_function pCallable, const math::vec2& pA, const math::vec2& pB) -> bool
+	state["physics_raycast_each"] = [this, &pScene](sol::safe_function pCallable, const math::vec2& pA, const math::vec2& pB) -> bool
 	{
 		bool hit_once = false;
 		sol::table result_info = state.create_table();
-		pPhysics.raycast(
+		get_physics().raycast(
 			[this, &pCallable, &pScene, &hit_once, &result_info](const physics::raycast_hit_info& hit) {
 				hit_once = true;
 				result_info["normal"] = hit.normal;
@@ -460,9 +464,58 @@ void script_engine::register_physics_api(physics::physics_world& pPhysics, core:
 		return hit_once;
 	};
 
-	state["physics_test_aabb"] = [this, &pPhysics](const math::vec2& pA, const math::vec2& pB) -> bool
+	state["physics_test_aabb"] = [this](const math::vec2& pA, const math::vec2& pB) -> bool
 	{
-		return pPhysics.test_aabb({ pA, pB });
+		return get_physics().test_aabb({ pA, pB });
+	};
+
+	state["physics_raycast_batch"] = [this, &pScene](sol::table pRays) -> sol::table
+	{
+		// Read everything out of lua first so the rays can run on other threads.
+		std::vector<physics::ray> rays(pRays.size());
+		for (std::size_t i = 0; i < rays.size(); i++)
+		{
+			sol::table ray = pRays[i + 1];
+			rays[i] = { ray[1].get<math::vec2>(), ray[2].get<math::vec2>() };
+		}
+
+		const std::vector<physics::raycast_hit_info> hits = get_physics().raycast_closest(rays);
+
+		sol::table results = state.create_table(static_cast<int>(hits.size()), 0);
+		for (std::size_t i = 0; i < hits.size(); i++)
+		{
+			const physics::raycast_hit_info& hit = hits[i];
+			if (!hit)
+			{
+				results[i + 1] = false;
+				continue;
+			}
+			sol::table hit_info = state.create_table();
+			hit_info["normal"] = hit.normal;
+			hit_info["point"] = hit.point;
+			if (auto state_comp = pScene.get_component<scripting::event_state_component>(hit.object_id))
+				hit_info["object"] = state_comp->environment;
+			results[i + 1] = hit_info;
+		}
+		return results;
+	};
+
+	state["physics_test_aabb_batch"] = [this](sol::table pBoxes) -> sol::table
+	{
+		std::vector<math::aabb> boxes(pBoxes.size());
+		for (std::size_t i = 0; i < boxes.size(); i++)
+		{
+			sol::table box = pBoxes[i + 1];
+			boxes[i] = { box[1].get<math::vec2>(), box[2].get<math::vec2>() };
+		}
+
+		auto hits = std::make_unique<bool[]>(boxes.size());
+		get_physics().test_aabb(boxes, { hits.get(), boxes.size() });
+
+		sol::table results = state.create_table(static_cast<int>(boxes.size()), 0);
+		for (std::size_t i = 0; i < boxes.size(); i++)
+			results[i + 1] = hits[i];
+		return results;
 	};
 }
 
@@ -559,6 +612,42 @@ void script_engine::event_alarms(core::layer& pLayer, std::size_t pIndex)
 	pLayer.destroy_queued_components();
 }
 
+void script_engine::event_collisions(core::layer& pLayer, const physics::contact_buffer& pContacts, core::scene& pScene)
+{
+	if (pContacts.empty())
+		return;
+
+	// One call per object with every object it touched in the 'collisions' variable.
+	const auto dispatch = [&](core::bucket pBucket, const physics::contact_buffer::contact_map& pMap, const std::string& pEvent_name)
+	{
+		for (auto& [id, on_collision, state] :
+			pLayer.each<event_component, event_state_component>({ core::bucket_select<event_component>{ pBucket } }))
+		{
+			auto iter = pMap.find(id);
+			if (iter == pMap.end())
+				continue;
+
+			sol::table collisions = this->state.create_table(static_cast<int>(iter->second.size()), 0);
+			for (std::size_t i = 0; i < iter->second.size(); i++)
+			{
+				sol::table collision = this->state.create_table();
+				if (auto state_comp = pScene.get_component<event_state_component>(iter->second[i]))
+					collision["object"] = state_comp->environment;
+				collisions[i + 1] = collision;
+			}
+			state.environment["collisions"] = collisions;
+			run_script(on_collision.source_script, state.environment, pEvent_name, id);
+			state.environment["collisions"] = sol::lua_nil;
+		}
+	};
+
+	// Event: Collision Begin
+	dispatch(event_selector::collision_begin::bucket, pContacts.begin, "Collision Begin");
+	// Event: Collision End
+	dispatch(event_selector::collision_end::bucket, pContacts.end, "Collision End");
+	pLayer.destroy_queued_components();
+}
+
 void script_engine::event_update(core::layer& pLayer)
 {
 	// Event: Update
@@ -0,0 +1,62 @@
+#include <wge/util/thread_pool.hpp>
+
+namespace wge::util
+{
+
+std::size_t thread_pool::get_default_thread_count() noexcept
+{
+	const std::size_t hardware = std::thread::hardware_concurrency();
+	return hardware > 1 ? hardware - 1 : 0;
+}
+
+thread_pool::thread_pool(std::size_t pThread_count)
+{
+	mThreads.reserve(pThread_count);
+	mJobs.reserve(pThread_count);
+	for (std::size_t i = 0; i < pThread_count; i++)
+		mThreads.emplace_back([this]() { worker(); });
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard lock{ mMutex };
+		mStopping = true;
+	}
+	mCondition.notify_all();
+	for (auto& i : mThreads)
+		i.join();
+}
+
+void thread_pool::push(job pJob)
+{
+	{
+		std::lock_guard lock{ mMutex };
+		mJobs.push_back(pJob);
+	}
+	mCondition.notify_one();
+}
+
+void thread_pool::worker()
+{
+	for (;;)
+	{
+		job current;
+		{
+			std::unique_lock lock{ mMutex };
+			mCondition.wait(lock, [this]() { return mStopping || mNext_job < mJobs.size(); });
+			// Finish whatever is left in the queue before stopping.
+			if (mNext_job == mJobs.size())
+				return;
+			current = mJobs[mNext_job++];
+			if (mNext_job == mJobs.size())
+			{
+				mJobs.clear();
+				mNext_job = 0;
+			}
+		}
+		current.function(current.data);
+	}
+}
+
+} // namespace wge::util
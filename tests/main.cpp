@@ -13,9 +13,62 @@
 #include <wge/math/vector.hpp>
 #include <wge/util/ptr.hpp>
 #include <wge/core/scene_resource.hpp>
+#include <wge/graphics/texture_atlas.hpp>
+#include <wge/graphics/graphics.hpp>
+#include <wge/graphics/renderer.hpp>
+#include <wge/graphics/sprite.hpp>
+#include <wge/util/thread_pool.hpp>
+#include <wge/util/clock.hpp>
+#include <wge/graphics/software_framebuffer.hpp>
+#include <wge/graphics/recording_backend.hpp>
+#include <wge/physics/physics_world.hpp>
+#include <wge/physics/physics_component.hpp>
+#include <wge/physics/tilemap_collider.hpp>
+#include <wge/math/transformations.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <vector>
 
 using namespace wge;
 
+namespace
+{
+
+// Heap allocations are only counted while this is enabled.
+// Atomic since the render workers allocate too.
+std::atomic<bool> gCount_allocations{ false };
+std::atomic<std::size_t> gAllocation_count{ 0 };
+
+} // namespace
+
+void* operator new(std::size_t pSize)
+{
+	if (gCount_allocations)
+		++gAllocation_count;
+	if (void* ptr = std::malloc(pSize == 0 ? 1 : pSize))
+		return ptr;
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* pPtr) noexcept
+{
+	std::free(pPtr);
+}
+
+void operator delete(void* pPtr, std::size_t) noexcept
+{
+	std::free(pPtr);
+}
+
 struct tracker
 {
 	tracker() noexcept = default;
@@ -31,6 +84,26 @@ struct tracker
 	std::size_t moves = 0;
 };
 
+// Loads a single frame sprite from a png written to the temp directory
+// so it goes through the atlas like a sprite loaded by the engine.
+core::asset::ptr load_test_sprite(graphics::graphics& pGraphics, const std::string& pName, const math::ivec2& pSize)
+{
+	const auto directory = std::filesystem::temp_directory_path() / "wge_test_sprites";
+	std::filesystem::create_directories(directory);
+	REQUIRE(graphics::image{ pSize, { 255, 255, 255, 255 } }.save_png((directory / (pName + ".png")).string()));
+	auto resource = std::make_unique<graphics::sprite>();
+	resource->set_texture_implementation(pGraphics.get_graphics_backend()->create_texture_impl());
+	resource->set_residency(pGraphics.get_image_residency());
+	resource->set_atlas(&pGraphics.get_sprite_atlas());
+	resource->set_frame_size({ 16, 16 });
+	resource->resize_animation(1);
+	resource->set_location(core::primary_asset_location::create(directory, pName));
+	resource->load();
+	auto asset = std::make_shared<core::asset>();
+	asset->set_resource(std::move(resource));
+	return asset;
+}
+
 TEST_CASE("A family represents a type")
 {
 	REQUIRE(core::family::from<int>() == core::family::from<int>());
@@ -212,6 +285,14 @@ TEST_CASE("destruction_queue works")
 	REQUIRE_FALSE(mgr.get_storage<com2>().has(id));
 	REQUIRE(queue.empty());
 
+	// Either kind of entry makes it non-empty.
+	queue.push_object(id);
+	REQUIRE_FALSE(queue.empty());
+	queue.clear();
+	queue.push_component(id, core::component_type::from<com1>());
+	REQUIRE_FALSE(queue.empty());
+	queue.clear();
+
 	// Clearing the queue should leave it empty.
 	queue.push_component(id, core::component_type::from<com1>());
 	queue.push_object(id);
@@ -235,3 +316,1037 @@ TEST_CASE("enumerate{} creates pears")
 		REQUIRE(arr[i] == i);
 }
 
+
+TEST_CASE("packed_vertex_2d converts to and from vertex_2d")
+{
+	using namespace graphics;
+	vertex_2d vert;
+	vert.position = { 12.5f, -3.f };
+	vert.uv = { 0.f, 1.f };
+	vert.color = { 1, 0, 1, 1 };
+
+	packed_vertex_2d packed{ vert };
+	REQUIRE(packed.position == vert.position);
+	REQUIRE(packed.get_uv() == vert.uv);
+	REQUIRE(packed.color.r == 255);
+	REQUIRE(packed.color.g == 0);
+
+	vertex_2d unpacked = packed.unpack();
+	REQUIRE(unpacked.position == vert.position);
+	REQUIRE(unpacked.uv == vert.uv);
+	REQUIRE(unpacked.color.b == 1.f);
+
+	// UVs out of range are clamped.
+	packed.set_uv({ -1.f, 2.f });
+	REQUIRE(packed.get_uv() == math::vec2{ 0, 1 });
+}
+
+TEST_CASE("tile_grid stores, fills, and copies tiles")
+{
+	core::tile_grid grid;
+	REQUIRE(grid.empty());
+
+	// Negative positions land in their own chunk.
+	REQUIRE(grid.set({ -1, -1 }, { 2, 3 }));
+	REQUIRE(grid.get({ -1, -1 }));
+	REQUIRE(grid.get({ -1, -1 })->get_uv() == math::ivec2{ 2, 3 });
+	REQUIRE(grid.get({ 0, 0 }) == nullptr);
+	REQUIRE(core::get_tilemap_chunk({ -1, -1 }) == math::ivec2{ -1, -1 });
+
+	// Setting the same tile again isn't a change.
+	REQUIRE_FALSE(grid.set({ -1, -1 }, { 2, 3 }));
+
+	// Uvs that don't fit in a cell are rejected.
+	REQUIRE_FALSE(grid.set({ 100, 100 }, { 70000, 0 }));
+	REQUIRE_FALSE(grid.set({ 100, 100 }, { 0, -1 }));
+	REQUIRE(grid.get({ 100, 100 }) == nullptr);
+	REQUIRE(grid.get_chunks().size() == 1);
+
+	grid.fill({ 0, 0 }, { 40, 2 }, { 1, 1 });
+	REQUIRE(grid.get_tile_count() == 81);
+	REQUIRE(grid.get_chunks().size() == 3);
+
+	// Overlapping copy.
+	grid.copy({ 0, 0 }, { 2, 1 }, { 1, 0 });
+	REQUIRE(grid.get({ 2, 0 })->get_uv() == math::ivec2{ 1, 1 });
+
+	// Chunks are released when they become empty.
+	REQUIRE(grid.clear({ -1, -1 }));
+	REQUIRE_FALSE(grid.clear({ -1, -1 }));
+	REQUIRE(grid.get_chunks().size() == 2);
+
+	std::size_t visited = 0;
+	grid.for_each([&](math::ivec2, const core::tile_cell&) { ++visited; });
+	REQUIRE(visited == 80);
+}
+
+TEST_CASE("texture_atlas packs and repacks images")
+{
+	graphics::atlas_settings settings;
+	settings.page_size = { 64, 64 };
+	settings.padding = 2;
+	graphics::texture_atlas atlas{ settings };
+
+	int a_key = 0, b_key = 0;
+	graphics::atlas_region a_region, b_region;
+	REQUIRE(atlas.insert(&a_key, graphics::image{ math::ivec2{ 30, 30 } }, [&](const graphics::atlas_region& pRegion) { a_region = pRegion; }));
+	REQUIRE(atlas.insert(&b_key, graphics::image{ math::ivec2{ 30, 30 } }, [&](const graphics::atlas_region& pRegion) { b_region = pRegion; }));
+
+	// Both fit on the same page without overlapping.
+	REQUIRE(a_region.page_texture != nullptr);
+	REQUIRE(a_region.page_texture == b_region.page_texture);
+	REQUIRE_FALSE(a_region.uv.intersect(b_region.uv));
+	REQUIRE(atlas.get_stats().page_count == 1);
+	// The page keeps its pixels for repacking.
+	REQUIRE(atlas.get_stats().cpu_bytes == 64 * 64 * 4);
+
+	// Too big for a page.
+	int big_key = 0;
+	REQUIRE_FALSE(atlas.insert(&big_key, graphics::image{ math::ivec2{ 100, 10 } }, {}));
+
+	// Resizing an image moves it.
+	REQUIRE(atlas.insert(&a_key, graphics::image{ math::ivec2{ 60, 20 } }, [&](const graphics::atlas_region& pRegion) { a_region = pRegion; }));
+	REQUIRE(atlas.get_stats().image_count == 2);
+	REQUIRE_FALSE(a_region.uv.intersect(b_region.uv));
+
+	// Removing only frees the space. Nothing moves until the page is repacked.
+	const graphics::atlas_region b_before = b_region;
+	b_region = graphics::atlas_region{};
+	atlas.remove(&a_key);
+	REQUIRE_FALSE(atlas.contains(&a_key));
+	REQUIRE(b_region.page_texture == nullptr);
+	atlas.update_textures();
+	REQUIRE(b_region.page_texture == b_before.page_texture);
+	REQUIRE(atlas.get_stats().occupancy > 0.f);
+
+	// Images that no longer fit get their pixels back.
+	math::ivec2 dropped_size{ 0, 0 };
+	REQUIRE(atlas.insert(&b_key, graphics::image{ math::ivec2{ 30, 30 } }, [&](const graphics::atlas_region& pRegion)
+	{
+		b_region = pRegion;
+		if (pRegion.dropped_pixels)
+			dropped_size = pRegion.dropped_pixels->get_size();
+	}));
+	settings.page_size = { 16, 16 };
+	atlas.set_settings(settings);
+	REQUIRE(b_region.page_texture == nullptr);
+	REQUIRE(dropped_size == math::ivec2{ 30, 30 });
+}
+
+TEST_CASE("renderer makes no heap allocations once warmed up")
+{
+	graphics::graphics gfx;
+	gfx.initialize(graphics::window_backend_type::null, graphics::backend_type::software);
+	graphics::renderer renderer{ gfx };
+	renderer.set_framebuffer(gfx.get_graphics_backend()->create_framebuffer());
+	renderer.set_raw_view({ -100, -100, 100, 100 });
+
+	// Sprites with real pixels so they go through the atlas and get instanced.
+	const auto first_asset = load_test_sprite(gfx, "first", { 16, 16 });
+	const auto second_asset = load_test_sprite(gfx, "second", { 16, 16 });
+	// Too big for an atlas page so it draws from its own texture.
+	const auto large_asset = load_test_sprite(gfx, "large", { 4096, 16 });
+	REQUIRE(first_asset->get_resource<graphics::sprite>()->is_in_atlas());
+	REQUIRE_FALSE(large_asset->get_resource<graphics::sprite>()->is_in_atlas());
+
+	const auto add_sprites = [&](core::layer& pLayer)
+	{
+		for (int i = 0; i < 100; i++)
+		{
+			core::object obj = pLayer.add_object();
+			obj.add_component(math::transform{});
+			if (i % 10 == 0)
+				obj.add_component(graphics::sprite_component{ large_asset });
+			else
+				obj.add_component(graphics::sprite_component{ i % 2 == 0 ? first_asset : second_asset });
+		}
+	};
+
+	core::layer layer;
+	add_sprites(layer);
+
+	// Let everything grow to its working size.
+	renderer.render_layer(layer);
+	std::size_t arena_allocations = renderer.get_arena_allocation_count();
+
+	gAllocation_count = 0;
+	gCount_allocations = true;
+	for (int i = 0; i < 1000; i++)
+		renderer.render_layer(layer);
+	gCount_allocations = false;
+
+	REQUIRE(gAllocation_count == 0);
+	REQUIRE(renderer.get_arena_allocation_count() == arena_allocations);
+	REQUIRE(renderer.get_last_layer_stats().sprites_drawn == 100);
+	// The two small sprites share a page.
+	REQUIRE(renderer.get_last_layer_stats().texture_switches_saved > 0);
+
+	// Building the layers on the workers shouldn't allocate either.
+	core::scene scene;
+	for (int i = 0; i < 4; i++)
+		add_sprites(scene.add_layer());
+	renderer.render_scene(scene);
+	arena_allocations = renderer.get_arena_allocation_count();
+
+	gAllocation_count = 0;
+	gCount_allocations = true;
+	for (int i = 0; i < 100; i++)
+		renderer.render_scene(scene);
+	gCount_allocations = false;
+
+	REQUIRE(gAllocation_count == 0);
+	REQUIRE(renderer.get_arena_allocation_count() == arena_allocations);
+	REQUIRE(renderer.get_scene_stats().size() == 4);
+}
+
+TEST_CASE("threaded submission draws the same as submitting in place")
+{
+	graphics::graphics gfx;
+	gfx.initialize(graphics::window_backend_type::null, graphics::backend_type::software);
+	const auto sprite_asset = load_test_sprite(gfx, "submitted", { 16, 16 });
+
+	core::scene scene;
+	for (int i = 0; i < 3; i++)
+	{
+		core::layer& layer = scene.add_layer();
+		for (int j = 0; j < 10; j++)
+		{
+			core::object obj = layer.add_object();
+			obj.add_component(math::transform{ math::vec2{ static_cast<float>(j * 10 - 50), static_cast<float>(i * 20 - 20) } });
+			obj.add_component(graphics::sprite_component{ sprite_asset });
+		}
+	}
+
+	const auto render = [&](bool pThreaded)
+	{
+		graphics::renderer renderer{ gfx };
+		renderer.set_threaded_submission(pThreaded);
+		auto fb = std::dynamic_pointer_cast<graphics::software_framebuffer>(gfx.get_graphics_backend()->create_framebuffer());
+		fb->clear();
+		renderer.set_framebuffer(fb);
+		renderer.set_raw_view({ -100, -100, 100, 100 });
+		renderer.render_scene(scene);
+		// Known as soon as the layers are built.
+		REQUIRE(renderer.get_scene_stats().size() == 3);
+		REQUIRE(renderer.get_last_layer_stats().sprites_drawn == 10);
+		renderer.wait_for_submission();
+		return fb->get_image();
+	};
+
+	const graphics::image in_place = render(false);
+	const graphics::image threaded = render(true);
+	REQUIRE(in_place.get_raw().size() == threaded.get_raw().size());
+	REQUIRE(std::equal(in_place.get_raw().begin(), in_place.get_raw().end(), threaded.get_raw().begin()));
+}
+
+TEST_CASE("frame_arena reuses its memory after a reset")
+{
+	util::frame_arena arena{ 64 };
+	auto a = arena.allocate<int>(8);
+	auto b = arena.allocate<double>(32);
+	REQUIRE(a.size() == 8);
+	REQUIRE(b.size() == 32);
+	REQUIRE(reinterpret_cast<std::uintptr_t>(b.data()) % alignof(double) == 0);
+	REQUIRE(arena.get_heap_allocation_count() == 2);
+
+	// The blocks are merged so the same frame fits in one.
+	arena.reset();
+	REQUIRE(arena.get_heap_allocation_count() == 3);
+	for (int i = 0; i < 10; i++)
+	{
+		arena.allocate<int>(8);
+		arena.allocate<double>(32);
+		arena.reset();
+	}
+	REQUIRE(arena.get_heap_allocation_count() == 3);
+}
+
+TEST_CASE("thread_pool runs every index of a parallel_for once")
+{
+	util::thread_pool pool{ 4 };
+	std::vector<std::atomic<int>> counts(1000);
+	pool.parallel_for(counts.size(), [&](std::size_t i)
+	{
+		++counts[i];
+	});
+	for (auto& i : counts)
+		REQUIRE(i == 1);
+
+	REQUIRE_THROWS(pool.parallel_for(10, [](std::size_t i)
+	{
+		if (i == 5)
+			throw std::runtime_error("failed");
+	}));
+}
+
+TEST_CASE("software backend draws textured quads and instances the same")
+{
+	auto backend = graphics::graphics_backend::create(graphics::backend_type::software);
+	backend->initialize();
+
+	graphics::image pixels{ math::ivec2{ 2, 2 } };
+	pixels.set_pixel({ 0, 0 }, { 255, 0, 0, 255 });
+	pixels.set_pixel({ 1, 0 }, { 0, 255, 0, 255 });
+	pixels.set_pixel({ 0, 1 }, { 0, 0, 255, 255 });
+	pixels.set_pixel({ 1, 1 }, { 255, 255, 255, 255 });
+	graphics::texture tex;
+	tex.set_implementation(backend->create_texture_impl());
+	tex.set_image(pixels);
+
+	const auto projection = math::ortho(math::aabb{ 0, 0, 100, 100 });
+	const auto render = [&](const graphics::render_batch_2d& pBatch)
+	{
+		auto fb = std::dynamic_pointer_cast<graphics::software_framebuffer>(backend->create_framebuffer());
+		REQUIRE(fb);
+		fb->resize(100, 100);
+		fb->clear({ 0, 0, 0, 1 });
+		backend->render_batch(fb, projection, pBatch);
+		return fb->get_image();
+	};
+
+	// A 40x40 quad with its top-left corner at (10, 20).
+	graphics::render_batch_2d quad;
+	quad.rendertexture = &tex;
+	const math::vec2 corners[4] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+	for (const auto& i : corners)
+	{
+		graphics::vertex_2d vertex;
+		vertex.position = math::vec2{ 10, 20 } + i * 40.f;
+		vertex.uv = i;
+		quad.vertices.push_back(vertex);
+	}
+	quad.indexes = { 0, 1, 2, 2, 3, 0 };
+	const graphics::image result = render(quad);
+
+	std::size_t covered = 0;
+	for (int y = 0; y < result.get_height(); y++)
+		for (int x = 0; x < result.get_width(); x++)
+		{
+			const graphics::color8 pixel = result.get_pixel({ x, y });
+			if (pixel.r != 0 || pixel.g != 0 || pixel.b != 0)
+				++covered;
+		}
+	REQUIRE(covered == 40 * 40);
+	const auto same = [](const graphics::color8& pL, const graphics::color8& pR)
+	{
+		return pL.r == pR.r && pL.g == pR.g && pL.b == pR.b && pL.a == pR.a;
+	};
+	REQUIRE(same(result.get_pixel({ 10, 20 }), { 255, 0, 0, 255 }));
+	REQUIRE(same(result.get_pixel({ 49, 20 }), { 0, 255, 0, 255 }));
+	REQUIRE(same(result.get_pixel({ 10, 59 }), { 0, 0, 255, 255 }));
+	REQUIRE(same(result.get_pixel({ 49, 59 }), { 255, 255, 255, 255 }));
+	REQUIRE(same(result.get_pixel({ 9, 20 }), { 0, 0, 0, 255 }));
+
+	// The same quad as an instance.
+	graphics::sprite_instance_2d instance;
+	instance.position = { 10, 20 };
+	instance.size = { 40, 40 };
+	instance.set_uv_rect({ 0, 0, 1, 1 });
+	graphics::render_batch_2d instanced;
+	instanced.rendertexture = &tex;
+	instanced.instances = util::span<const graphics::sprite_instance_2d>{ &instance, 1 };
+	const graphics::image instanced_result = render(instanced);
+	REQUIRE(instanced_result.get_raw().size() == result.get_raw().size());
+	REQUIRE(std::equal(result.get_raw().begin(), result.get_raw().end(), instanced_result.get_raw().begin()));
+}
+
+TEST_CASE("recording_backend counts batches per layer and captures frames")
+{
+	auto recorder = std::make_shared<graphics::recording_backend>(
+		graphics::graphics_backend::create(graphics::backend_type::software));
+	recorder->initialize();
+	auto fb = recorder->create_framebuffer();
+	const auto projection = math::ortho(math::aabb{ 0, 0, 100, 100 });
+
+	graphics::render_batch_2d quad;
+	for (const math::vec2& i : { math::vec2{ 0, 0 }, math::vec2{ 1, 0 }, math::vec2{ 1, 1 }, math::vec2{ 0, 1 } })
+	{
+		graphics::vertex_2d vertex;
+		vertex.position = i * 10.f;
+		quad.vertices.push_back(vertex);
+	}
+	quad.indexes = { 0, 1, 2, 2, 3, 0 };
+
+	recorder->capture_next_frame();
+	recorder->begin_frame();
+	recorder->begin_layer("background");
+	recorder->render_batch(fb, projection, quad);
+	recorder->begin_layer("foreground");
+	recorder->render_batch(fb, projection, quad);
+	recorder->render_batch(fb, projection, quad);
+	recorder->end_frame();
+
+	const auto& stats = recorder->get_last_frame_stats();
+	REQUIRE(stats.layers.size() == 2);
+	REQUIRE(stats.layers[0].name == "background");
+	REQUIRE(stats.layers[0].stats.batches == 1);
+	REQUIRE(stats.layers[1].stats.batches == 2);
+	REQUIRE(stats.total.batches == 3);
+	REQUIRE(stats.total.vertices == 12);
+	REQUIRE(stats.total.indexes == 18);
+
+	REQUIRE(recorder->get_last_capture());
+	graphics::captured_frame loaded;
+	loaded.deserialize(recorder->get_last_capture()->serialize());
+	REQUIRE(loaded.batches.size() == 3);
+	REQUIRE(loaded.batches[1].layer == "foreground");
+	REQUIRE(loaded.batches[1].vertices.size() == 4);
+	REQUIRE(loaded.batches[1].indexes.size() == 6);
+
+	// Retained geometry is read back from the wrapped backend when captured.
+	auto geometry = recorder->create_retained_geometry();
+	std::vector<graphics::packed_vertex_2d> packed;
+	for (const auto& i : quad.vertices)
+		packed.emplace_back(i);
+	geometry->update(packed, quad.indexes);
+	graphics::render_batch_2d retained;
+	retained.retained = geometry.get();
+
+	recorder->begin_frame();
+	recorder->render_batch(fb, projection, retained);
+	recorder->end_frame();
+	// Retained geometry counts even though nothing was uploaded this frame.
+	REQUIRE(recorder->get_last_frame_stats().total.vertices == 4);
+	REQUIRE(recorder->get_last_frame_stats().total.indexes == 6);
+	recorder->capture_next_frame();
+	recorder->begin_frame();
+	recorder->render_batch(fb, projection, retained);
+	recorder->end_frame();
+
+	REQUIRE(recorder->get_last_capture()->batches.size() == 1);
+	REQUIRE(recorder->get_last_capture()->batches[0].vertices.size() == 4);
+	REQUIRE(recorder->get_last_capture()->batches[0].indexes.size() == 6);
+}
+
+TEST_CASE("sprite frame table follows the sprite settings")
+{
+	graphics::sprite sprite;
+	sprite.set_frame_size({ 16, 8 });
+	sprite.resize_animation(2);
+	sprite.set_default_anchor({ 8, 4 });
+	sprite.set_default_duration(0.5f);
+
+	graphics::sprite::frame_info info;
+	info.anchor = math::vec2{ 0, 0 };
+	info.duration = 0.25f;
+	sprite.set_frame_info(1, info);
+
+	const auto& first = sprite.get_frame_geometry(0);
+	REQUIRE(first.quad.min == math::vec2{ -8, -4 });
+	REQUIRE(first.quad.max == math::vec2{ 8, 4 });
+	REQUIRE(first.duration == 0.5f);
+
+	const auto& second = sprite.get_frame_geometry(1);
+	REQUIRE(second.quad.min == math::vec2{ 0, 0 });
+	REQUIRE(second.quad.max == math::vec2{ 16, 8 });
+	REQUIRE(second.duration == 0.25f);
+
+	sprite.set_default_anchor({ 0, 8 });
+	REQUIRE(sprite.get_frame_anchor(0) == math::vec2{ 0, 8 });
+	REQUIRE(sprite.get_frame_anchor(1) == math::vec2{ 0, 0 });
+
+	// The same edits on another sprite never give the same version.
+	graphics::sprite other;
+	other.set_frame_size({ 16, 8 });
+	REQUIRE(other.get_frame_table_version() != sprite.get_frame_table_version());
+	REQUIRE(graphics::sprite{}.get_frame_table_version() != graphics::sprite{}.get_frame_table_version());
+}
+
+TEST_CASE("renderer reuses the vertices of sprites that didn't change")
+{
+	graphics::graphics gfx;
+	gfx.initialize(graphics::window_backend_type::null, graphics::backend_type::null);
+	graphics::renderer renderer{ gfx };
+	renderer.set_framebuffer(gfx.get_graphics_backend()->create_framebuffer());
+	renderer.set_raw_view({ -100, -100, 100, 100 });
+
+	auto sprite_asset = std::make_shared<core::asset>();
+	auto sprite_resource = std::make_unique<graphics::sprite>();
+	sprite_resource->set_frame_size({ 16, 16 });
+	sprite_resource->resize_animation(1);
+	sprite_asset->set_resource(std::move(sprite_resource));
+
+	core::layer layer;
+	core::object moving;
+	for (int i = 0; i < 10; i++)
+	{
+		moving = layer.add_object();
+		moving.add_component(math::transform{});
+		moving.add_component(graphics::sprite_component{ sprite_asset });
+	}
+
+	renderer.render_layer(layer);
+	REQUIRE(renderer.get_last_layer_stats().sprites_reused == 0);
+	renderer.render_layer(layer);
+	REQUIRE(renderer.get_last_layer_stats().sprites_reused == 10);
+
+	moving.get_component<math::transform>()->position = { 1, 0 };
+	renderer.render_layer(layer);
+	REQUIRE(renderer.get_last_layer_stats().sprites_reused == 9);
+
+	sprite_asset->get_resource<graphics::sprite>()->set_default_anchor({ 8, 8 });
+	renderer.render_layer(layer);
+	REQUIRE(renderer.get_last_layer_stats().sprites_reused == 0);
+}
+
+TEST_CASE("textures share or discard their pixels based on residency")
+{
+	auto backend = graphics::graphics_backend::create(graphics::backend_type::software);
+	backend->initialize();
+
+	auto pixels = std::make_shared<const graphics::image>(math::ivec2{ 8, 4 });
+
+	graphics::texture kept;
+	kept.set_implementation(backend->create_texture_impl());
+	kept.set_image(pixels);
+	REQUIRE(kept.get_image() == pixels);
+
+	graphics::texture discarded;
+	discarded.set_residency(graphics::image_residency::discard);
+	discarded.set_implementation(backend->create_texture_impl());
+	discarded.set_image(pixels);
+	REQUIRE(discarded.get_image() == nullptr);
+	REQUIRE(discarded.get_size() == math::ivec2{ 8, 4 });
+	REQUIRE(pixels.use_count() == 2);
+
+	// Nothing to hand the pixels to yet.
+	graphics::texture no_impl;
+	no_impl.set_residency(graphics::image_residency::discard);
+	no_impl.set_image(pixels);
+	REQUIRE(no_impl.get_image() == pixels);
+}
+
+TEST_CASE("layer version changes when objects or components change")
+{
+	core::layer layer;
+	auto version = layer.get_version();
+
+	core::object obj = layer.add_object();
+	REQUIRE(layer.get_version() != version);
+	version = layer.get_version();
+
+	obj.add_component(math::transform{});
+	REQUIRE(layer.get_version() != version);
+	version = layer.get_version();
+
+	obj.get_component<math::transform>()->position = { 1, 1 };
+	REQUIRE(layer.get_version() == version);
+	layer.mark_changed();
+	REQUIRE(layer.get_version() != version);
+	version = layer.get_version();
+
+	obj.destroy();
+	REQUIRE(layer.get_version() != version);
+	version = layer.get_version();
+
+	// Nothing was queued so nothing changed.
+	layer.destroy_queued_components();
+	REQUIRE(layer.get_version() == version);
+}
+
+TEST_CASE("physics interpolation is undone by the next tick")
+{
+	physics::physics_world world;
+	core::layer layer;
+	core::object obj = layer.add_object();
+	obj.add_component(math::transform{});
+	obj.add_component(physics::physics_component{});
+
+	const auto tick = [&]()
+	{
+		world.preupdate(layer, 1);
+		world.step(1.f / 60.f);
+		world.update_object_transforms(layer);
+		world.postupdate(layer);
+	};
+
+	tick();
+	obj.get_component<math::transform>()->position = { 10, 0 };
+	tick();
+
+	world.interpolate(layer, 0.5f);
+	REQUIRE(obj.get_component<math::transform>()->position == math::vec2{ 5, 0 });
+
+	// The body never moved on its own so it stays where it was last put.
+	tick();
+	REQUIRE(obj.get_component<math::transform>()->position == math::vec2{ 10, 0 });
+}
+
+TEST_CASE("physics sync leaves resting bodies alone")
+{
+	physics::physics_world world;
+	world.set_gravity({ 0, 0 });
+	core::layer layer;
+	core::object obj = layer.add_object();
+	obj.add_component(math::transform{});
+	obj.add_component(physics::physics_component{});
+
+	const auto tick = [&]()
+	{
+		world.preupdate(layer, 1);
+		world.step(1.f / 60.f);
+		world.update_object_transforms(layer);
+		world.postupdate(layer);
+	};
+
+	tick();
+	b2Body* body = world.get_world()->GetBodyList();
+	REQUIRE(body);
+	body->SetType(b2_dynamicBody);
+	body->SetAwake(false);
+
+	tick();
+	REQUIRE_FALSE(body->IsAwake());
+
+	// Moving it from gameplay code pushes the new transform into the body.
+	obj.get_component<math::transform>()->position = { 3, 4 };
+	world.postupdate(layer);
+	REQUIRE(body->GetPosition().x == 3.f);
+	REQUIRE(body->GetPosition().y == 4.f);
+}
+
+TEST_CASE("tilemap collision merges tiles and rebuilds changed chunks")
+{
+	physics::physics_world world;
+	core::layer layer;
+	core::tile_grid* grid = layer.layer_components.insert(core::tile_grid{});
+	layer.layer_components.insert(physics::tilemap_collider{});
+
+	const auto count_fixtures = [&]()
+	{
+		std::size_t count = 0;
+		for (b2Body* body = world.get_world()->GetBodyList(); body; body = body->GetNext())
+			for (b2Fixture* fixture = body->GetFixtureList(); fixture; fixture = fixture->GetNext())
+				++count;
+		return count;
+	};
+
+	// One box per full chunk.
+	grid->fill({ 0, 0 }, { 64, 64 }, { 0, 0 });
+	world.preupdate(layer, 1);
+	REQUIRE(count_fixtures() == 4);
+
+	// A hole splits its chunk into four boxes around it.
+	grid->clear({ 5, 5 });
+	REQUIRE(physics::merge_tile_rects(grid->get_chunks().at(core::get_tilemap_chunk_key({ 0, 0 }))).size() == 4);
+	world.preupdate(layer, 1);
+	REQUIRE(count_fixtures() == 7);
+
+	// Tiles are solid except where the hole is.
+	REQUIRE(world.test_aabb(math::aabb{ { 40.2f, 40.2f }, { 40.8f, 40.8f } }));
+	REQUIRE_FALSE(world.test_aabb(math::aabb{ { 5.2f, 5.2f }, { 5.8f, 5.8f } }));
+
+	// Removing the collider removes the fixtures.
+	layer.layer_components.remove<physics::tilemap_collider>();
+	world.preupdate(layer, 1);
+	REQUIRE(count_fixtures() == 0);
+}
+
+TEST_CASE("batched physics queries match single queries")
+{
+	physics::physics_world world;
+	core::layer layer;
+	core::tile_grid* grid = layer.layer_components.insert(core::tile_grid{});
+	layer.layer_components.insert(physics::tilemap_collider{});
+	grid->fill({ 10, 0 }, { 11, 100 }, { 0, 0 });
+	world.preupdate(layer, 1);
+
+	// Enough rays to be split across the workers. Every other one misses.
+	std::vector<physics::ray> rays;
+	for (int i = 0; i < 200; i++)
+	{
+		const float y = static_cast<float>(i % 2 == 0 ? i / 2 : -1 - i) + 0.5f;
+		rays.push_back({ { 0, y }, { 20, y } });
+	}
+
+	const std::vector<physics::raycast_hit_info> hits = world.raycast_closest(rays);
+	REQUIRE(hits.size() == rays.size());
+	for (std::size_t i = 0; i < rays.size(); i++)
+	{
+		const physics::raycast_hit_info single = world.raycast_closest(rays[i].from, rays[i].to);
+		REQUIRE(hits[i].hit == (i % 2 == 0));
+		REQUIRE(hits[i].hit == single.hit);
+		if (single.hit)
+			REQUIRE(hits[i].point == single.point);
+	}
+
+	std::vector<math::aabb> boxes;
+	for (int i = 0; i < 100; i++)
+		boxes.push_back(math::aabb{ { 9.5f, static_cast<float>(i) * 2.f }, { 9.8f, static_cast<float>(i) * 2.f + 0.5f } });
+	boxes.push_back(math::aabb{ { 10.2f, 50.2f }, { 10.8f, 50.8f } });
+	auto box_hits = std::make_unique<bool[]>(boxes.size());
+	world.test_aabb(boxes, { box_hits.get(), boxes.size() });
+	REQUIRE(std::count(box_hits.get(), box_hits.get() + boxes.size(), true) == 1);
+	REQUIRE(box_hits[boxes.size() - 1]);
+}
+
+TEST_CASE("sprite fixtures are only rebuilt when their shape changes")
+{
+	auto sprite_asset = std::make_shared<core::asset>();
+	auto sprite_resource = std::make_unique<graphics::sprite>();
+	sprite_resource->set_frame_size({ 16, 16 });
+	sprite_resource->resize_animation(1);
+	sprite_resource->set_aabb_collision(math::aabb{ 0, 0, 16, 16 });
+	sprite_asset->set_resource(std::move(sprite_resource));
+
+	physics::physics_world world;
+	core::layer layer;
+	core::object obj = layer.add_object();
+	obj.add_component(math::transform{});
+	obj.add_component(graphics::sprite_component{ sprite_asset });
+	obj.add_component(physics::physics_component{});
+	obj.add_component(physics::sprite_fixture{});
+
+	world.preupdate(layer, 16);
+	REQUIRE(world.get_fixture_rebuild_count() == 1);
+
+	// Jitter smaller than the scale step keeps the fixture.
+	obj.get_component<math::transform>()->scale = { 1.0001f, 0.9999f };
+	world.preupdate(layer, 16);
+	REQUIRE(world.get_fixture_rebuild_count() == 1);
+
+	obj.get_component<math::transform>()->scale = { 2, 2 };
+	world.preupdate(layer, 16);
+	REQUIRE(world.get_fixture_rebuild_count() == 2);
+
+	sprite_asset->get_resource<graphics::sprite>()->set_aabb_collision(math::aabb{ 0, 0, 8, 8 });
+	world.preupdate(layer, 16);
+	REQUIRE(world.get_fixture_rebuild_count() == 3);
+	REQUIRE(world.get_world()->GetBodyList()->GetFixtureList()->GetNext() == nullptr);
+}
+
+TEST_CASE("physics contacts are buffered per object")
+{
+	auto sprite_asset = std::make_shared<core::asset>();
+	auto sprite_resource = std::make_unique<graphics::sprite>();
+	sprite_resource->set_frame_size({ 1, 1 });
+	sprite_resource->resize_animation(1);
+	sprite_resource->set_aabb_collision(math::aabb{ 0, 0, 1, 1 });
+	sprite_asset->set_resource(std::move(sprite_resource));
+
+	physics::physics_world world;
+	world.set_gravity({ 0, 0 });
+	core::layer layer;
+	core::tile_grid* grid = layer.layer_components.insert(core::tile_grid{});
+	layer.layer_components.insert(physics::tilemap_collider{});
+	// Diagonal tiles can't be merged so they become two fixtures.
+	grid->set({ 1, 0 }, { 0, 0 });
+	grid->set({ 2, 1 }, { 0, 0 });
+
+	// Overlaps both tiles.
+	core::object obj = layer.add_object();
+	obj.add_component(math::transform{ math::vec2{ 1.5f, 0.5f } });
+	obj.add_component(graphics::sprite_component{ sprite_asset });
+	obj.add_component(physics::physics_component{});
+	obj.add_component(physics::sprite_fixture{});
+
+	const auto tick = [&]()
+	{
+		world.preupdate(layer, 1);
+		world.step(1.f / 60.f);
+		world.update_object_transforms(layer);
+		world.postupdate(layer);
+	};
+
+	world.preupdate(layer, 1);
+	for (b2Body* body = world.get_world()->GetBodyList(); body; body = body->GetNext())
+		if (body->GetUserData())
+			body->SetType(b2_dynamicBody);
+	tick();
+
+	// Two fixtures of the tilemap touch the object.
+	int touching = 0;
+	for (b2Contact* contact = world.get_world()->GetContactList(); contact; contact = contact->GetNext())
+		if (contact->IsTouching())
+			++touching;
+	REQUIRE(touching == 2);
+
+	// Both tiles are in the same layer so the object only hears about them once.
+	const auto& begin = world.get_contacts().begin;
+	REQUIRE(begin.size() == 1);
+	REQUIRE(begin.at(obj.get_id()) == std::vector<core::object_id>{ core::invalid_id });
+	REQUIRE(world.get_contacts().end.empty());
+	world.clear_contacts();
+
+	obj.get_component<math::transform>()->position = { 1.5f, 10 };
+	world.postupdate(layer);
+	tick();
+	REQUIRE(world.get_contacts().begin.empty());
+	REQUIRE(world.get_contacts().end.count(obj.get_id()) == 1);
+}
+
+TEST_CASE("isolated layers get their own physics world")
+{
+	physics::physics_world world;
+	world.set_gravity({ 0, 10 });
+
+	core::layer shared_layer;
+	core::layer isolated_layer;
+	isolated_layer.layer_components.insert(physics::isolated_physics{});
+	REQUIRE(&world.get_layer_world(shared_layer) == &world);
+	physics::physics_world& isolated = world.get_layer_world(isolated_layer);
+	REQUIRE(&isolated != &world);
+	REQUIRE(&world.get_layer_world(isolated_layer) == &isolated);
+	REQUIRE(isolated.get_gravity() == math::vec2{ 0, 10 });
+
+	const auto add_box = [](core::layer& pLayer)
+	{
+		core::object obj = pLayer.add_object();
+		obj.add_component(math::transform{});
+		obj.add_component(physics::physics_component{});
+		return obj;
+	};
+	core::object shared_obj = add_box(shared_layer);
+	core::object isolated_obj = add_box(isolated_layer);
+
+	world.preupdate(shared_layer, 1);
+	isolated.preupdate(isolated_layer, 1);
+	REQUIRE(world.get_world()->GetBodyCount() == 1);
+	REQUIRE(isolated.get_world()->GetBodyCount() == 1);
+	world.get_world()->GetBodyList()->SetType(b2_dynamicBody);
+	isolated.get_world()->GetBodyList()->SetType(b2_dynamicBody);
+
+	physics::physics_world* others[] = { &isolated };
+	world.step(1.f / 60.f, others);
+	world.update_object_transforms(shared_layer);
+	isolated.update_object_transforms(isolated_layer);
+
+	// Both worlds stepped the same way.
+	const math::vec2 shared_position = shared_obj.get_component<math::transform>()->position;
+	REQUIRE(shared_position.y > 0);
+	REQUIRE(isolated_obj.get_component<math::transform>()->position == shared_position);
+}
+
+TEST_CASE("bodies outside the activity regions are deactivated")
+{
+	physics::physics_world world;
+	world.set_gravity({ 0, 0 });
+	core::layer layer;
+	core::object obj = layer.add_object();
+	obj.add_component(math::transform{});
+	obj.add_component(physics::physics_component{});
+	world.preupdate(layer, 1);
+	b2Body* body = world.get_world()->GetBodyList();
+	body->SetType(b2_dynamicBody);
+
+	const math::aabb regions[] = { math::aabb{ 0, 0, 10, 10 } };
+	world.set_activity_regions(regions, 2);
+
+	const auto move_to = [&](float pX)
+	{
+		body->SetTransform({ pX, 5 }, 0);
+		world.step(1.f / 60.f);
+	};
+
+	move_to(5);
+	REQUIRE(body->IsActive());
+
+	// Inside the margin stays active.
+	move_to(11);
+	REQUIRE(body->IsActive());
+	move_to(13);
+	REQUIRE_FALSE(body->IsActive());
+	REQUIRE(world.get_inactive_body_count() == 1);
+
+	// Has to come all the way back to be active again.
+	move_to(11);
+	REQUIRE_FALSE(body->IsActive());
+	move_to(9);
+	REQUIRE(body->IsActive());
+	REQUIRE(world.get_inactive_body_count() == 0);
+
+	// Everything is simulated without regions.
+	move_to(100);
+	REQUIRE_FALSE(body->IsActive());
+	world.clear_activity_regions();
+	world.step(1.f / 60.f);
+	REQUIRE(body->IsActive());
+}
+
+TEST_CASE("physics stats describe the last step")
+{
+	physics::physics_world world;
+	core::layer layer;
+	core::tile_grid* grid = layer.layer_components.insert(core::tile_grid{});
+	layer.layer_components.insert(physics::tilemap_collider{});
+	grid->fill({ 0, 0 }, { 64, 32 }, { 0, 0 });
+	world.preupdate(layer, 1);
+
+	const std::string path = (std::filesystem::temp_directory_path() / "wge_physics_stats.csv").string();
+	world.set_stats_log(path, 2);
+	for (int i = 0; i < 3; i++)
+		world.step(1.f / 60.f);
+	world.set_stats_log({});
+
+	const physics::physics_stats& stats = world.get_stats();
+	REQUIRE(stats.bodies == 1);
+	REQUIRE(stats.fixtures == 2);
+	REQUIRE(stats.proxies == 2);
+	REQUIRE(stats.fixture_rebuilds == 0);
+
+	// The third row started a new file.
+	const auto count_lines = [](const std::string& pPath)
+	{
+		std::ifstream file(pPath);
+		std::size_t count = 0;
+		for (std::string line; std::getline(file, line);)
+			++count;
+		return count;
+	};
+	REQUIRE(count_lines(path) == 2);
+	REQUIRE(count_lines(path + ".old") == 3);
+	std::remove(path.c_str());
+	std::remove((path + ".old").c_str());
+}
+
+TEST_CASE("physics continues the same after a checkpoint as after restoring it")
+{
+	auto sprite_asset = std::make_shared<core::asset>();
+	auto sprite_resource = std::make_unique<graphics::sprite>();
+	sprite_resource->set_frame_size({ 1, 1 });
+	sprite_resource->resize_animation(1);
+	sprite_resource->set_aabb_collision(math::aabb{ 0, 0, 1, 1 });
+	sprite_asset->set_resource(std::move(sprite_resource));
+
+	physics::physics_world world;
+	world.set_gravity({ 0, 10 });
+	core::scene scene;
+	core::layer& layer = scene.add_layer();
+	core::tile_grid* grid = layer.layer_components.insert(core::tile_grid{});
+	layer.layer_components.insert(physics::tilemap_collider{});
+	grid->fill({ -20, 10 }, { 20, 11 }, { 0, 0 });
+	// Another layer in the same world and one with a world of its own.
+	core::layer& other_layer = scene.add_layer();
+	core::layer& isolated_layer = scene.add_layer();
+	isolated_layer.layer_components.insert(physics::isolated_physics{});
+
+	const auto add_box = [&](core::layer& pLayer, math::vec2 pPosition, float pRotation)
+	{
+		core::object obj = pLayer.add_object();
+		math::transform transform;
+		transform.position = pPosition;
+		transform.rotation = math::radians(pRotation);
+		obj.add_component(transform);
+		obj.add_component(graphics::sprite_component{ sprite_asset });
+		obj.add_component(physics::physics_component{});
+		obj.add_component(physics::sprite_fixture{});
+		return obj;
+	};
+
+	// A pile of boxes that will land on each other and the ground.
+	std::vector<core::object> objects;
+	for (int i = 0; i < 100; i++)
+	{
+		objects.push_back(add_box(layer, { static_cast<float>(i % 10) * 1.1f - 5.f, static_cast<float>(i / 10) * -1.5f },
+			static_cast<float>(i) * 0.1f));
+	}
+	objects.push_back(add_box(other_layer, { 10, 0 }, 0));
+	objects.push_back(add_box(isolated_layer, { -10, 0 }, 0));
+
+	const auto tick = [&]()
+	{
+		for (auto& i : scene)
+			world.get_layer_world(i).preupdate(i, 1);
+		world.step(1.f / 60.f);
+		world.get_layer_world(isolated_layer).step(1.f / 60.f);
+		for (auto& i : scene)
+		{
+			world.get_layer_world(i).update_object_transforms(i);
+			world.get_layer_world(i).postupdate(i);
+		}
+	};
+
+	const auto get_transforms = [&]()
+	{
+		std::vector<math::transform> result;
+		for (auto& i : objects)
+			result.push_back(*i.get_component<math::transform>());
+		return result;
+	};
+
+	const auto require_same = [&](const std::vector<math::transform>& pA, const std::vector<math::transform>& pB)
+	{
+		for (std::size_t i = 0; i < objects.size(); i++)
+		{
+			REQUIRE(std::memcmp(&pA[i].position, &pB[i].position, sizeof(math::vec2)) == 0);
+			REQUIRE(pA[i].rotation == pB[i].rotation);
+		}
+	};
+
+	for (auto& i : scene)
+		world.get_layer_world(i).preupdate(i, 1);
+	for (auto& i : scene)
+		for (b2Body* body = world.get_layer_world(i).get_world()->GetBodyList(); body; body = body->GetNext())
+			if (body->GetUserData())
+				body->SetType(b2_dynamicBody);
+	for (int i = 0; i < 30; i++)
+		tick();
+
+	const physics::scene_physics_snapshot checkpoint = world.checkpoint(scene);
+	REQUIRE(checkpoint.world.bodies.size() == objects.size() - 1);
+	REQUIRE(checkpoint.layers.size() == 3);
+	REQUIRE(checkpoint.layers[2]);
+	REQUIRE(checkpoint.layers[2]->bodies.size() == 1);
+	const std::vector<math::transform> at_checkpoint = get_transforms();
+
+	// The run that kept going from the checkpoint.
+	for (int i = 0; i < 60; i++)
+		tick();
+	const std::vector<math::transform> original = get_transforms();
+
+	const auto run = [&]()
+	{
+		world.restore(checkpoint, scene);
+		// Every layer was moved back, not just the first one.
+		require_same(get_transforms(), at_checkpoint);
+		for (int i = 0; i < 60; i++)
+			tick();
+		return get_transforms();
+	};
+
+	require_same(run(), original);
+	require_same(run(), original);
+
+	// The tiles are back after the restore.
+	REQUIRE(world.test_aabb(math::aabb{ { 0.2f, 10.2f }, { 0.8f, 10.8f } }));
+}
+
+TEST_CASE("physics snapshot and restore of 5k bodies take milliseconds")
+{
+	auto sprite_asset = std::make_shared<core::asset>();
+	auto sprite_resource = std::make_unique<graphics::sprite>();
+	sprite_resource->set_frame_size({ 1, 1 });
+	sprite_resource->resize_animation(1);
+	sprite_resource->set_aabb_collision(math::aabb{ 0, 0, 1, 1 });
+	sprite_asset->set_resource(std::move(sprite_resource));
+
+	physics::physics_world world;
+	core::scene scene;
+	core::layer& layer = scene.add_layer();
+	for (int i = 0; i < 5000; i++)
+	{
+		core::object obj = layer.add_object();
+		math::transform transform;
+		transform.position = { static_cast<float>(i % 100) * 2.f, static_cast<float>(i / 100) * 2.f };
+		obj.add_component(transform);
+		obj.add_component(graphics::sprite_component{ sprite_asset });
+		obj.add_component(physics::physics_component{});
+		obj.add_component(physics::sprite_fixture{});
+	}
+	world.preupdate(layer, 1);
+	world.step(1.f / 60.f);
+
+	util::clock timer;
+	const physics::physics_snapshot snapshot = world.snapshot();
+	const float snapshot_time = timer.restart();
+	world.restore(snapshot, scene);
+	const float restore_time = timer.restart();
+
+	WARN("5k body snapshot: " << snapshot_time * 1000.f << " ms (" << snapshot.get_size_bytes() / 1024 << " KB), restore: "
+		<< restore_time * 1000.f << " ms");
+	REQUIRE(snapshot.bodies.size() == 5000);
+	REQUIRE(world.get_world()->GetBodyCount() == 5000);
+	// Loose enough for unoptimized builds.
+	REQUIRE(snapshot_time < 0.1f);
+	REQUIRE(restore_time < 0.25f);
+}